@@ -56,6 +56,9 @@ namespace def
 		vf2d GetScale() const;
 		vf2d GetOffset() const;
 
+		// Maps world space to screen space
+		mat3 GetTransform() const;
+
 		vf2d GetOrigin();
 		vf2d GetEnd();
 
@@ -70,6 +73,20 @@ namespace def
 		bool IsPointVisible(const vf2d& point);
 		bool IsRectVisible(const vf2d& pos, const vf2d& size);
 
+		// Used by DrawSprite and DrawPartialSprite, LINEAR picks the nearest texel
+		void SetSampleMethod(Sprite::SampleMethod sampleMethod);
+		Sprite::SampleMethod GetSampleMethod() const;
+
+		// The texture calls pass world space coordinates to the engine and GetTransform()
+		// becomes its view transform, so the camera is applied by the GPU
+		void UseViewTransform(bool enable);
+		bool IsViewTransformUsed() const;
+
+		// Primitives that are smaller than the threshold (in pixels) on the screen are drawn
+		// as a single pixel, 0 disables it
+		void SetSplatThreshold(float threshold);
+		float GetSplatThreshold() const;
+
 	public:
 		bool Draw(const vi2d& pos, Pixel col = WHITE);
 		virtual bool Draw(int x, int y, Pixel col = WHITE);
@@ -113,6 +130,9 @@ namespace def
 		void FillWireFrameModel(const std::vector<vf2d>& modelCoordinates, const vf2d& pos, float rotation = 0.0f, float scale = 1.0f, const Pixel& col = WHITE);
 		virtual void FillWireFrameModel(const std::vector<vf2d>& modelCoordinates, float x, float y, float rotation = 0.0f, float scale = 1.0f, const Pixel& col = WHITE);
 
+		void DrawWireFrameModel(const std::vector<vf2d>& modelCoordinates, const mat3& transform, const Pixel& col = WHITE);
+		void FillWireFrameModel(const std::vector<vf2d>& modelCoordinates, const mat3& transform, const Pixel& col = WHITE);
+
 		void DrawTexture(const vf2d& pos, const Texture* tex, const vf2d& scale = { 1.0f, 1.0f }, const Pixel& tint = WHITE);
 		void DrawPartialTexture(const vf2d& pos, const Texture* tex, const vf2d& filePos, const vf2d& fileSize, const vf2d& scale = { 1.0f, 1.0f }, const Pixel& tint = WHITE);
 
@@ -121,6 +141,9 @@ namespace def
 		void DrawRotatedTexture(const vf2d& pos, const Texture* tex, float rotation, const vf2d& center = { 0.0f, 0.0f }, const vf2d& scale = { 1.0f, 1.0f }, const Pixel& tint = WHITE);
 		void DrawPartialRotatedTexture(const vf2d& pos, const Texture* tex, const vf2d& filePos, const vf2d& fileSize, float rotation, const vf2d& center = { 0.0f, 0.0f }, const vf2d& scale = { 1.0f, 1.0f }, const Pixel& tint = WHITE);
 
+		void DrawTexture(const mat3& transform, const Texture* tex, const Pixel& tint = WHITE);
+		void DrawPartialTexture(const mat3& transform, const Texture* tex, const vf2d& filePos, const vf2d& fileSize, const Pixel& tint = WHITE);
+
 		void DrawTexturePolygon(const std::vector<vf2d>& verts, const std::vector<Pixel>& cols, Texture::Structure structure);
 
 		void DrawTextureLine(const vi2d& pos1, const vi2d& pos2, const Pixel& col = WHITE);
@@ -138,11 +161,29 @@ namespace def
 
 		void DrawTextureString(const vi2d& pos, std::string_view text, const Pixel& col = def::WHITE, const vf2d& scale = { 1.0f, 1.0f });
 	
+	private:
+		// Walks the part of the destination rectangle that is on the draw target
+		// with the fixed point steps through the source rectangle
+		void BlitSprite(const vf2d& pos, const vi2d& filePos, const vi2d& fileSize, const Sprite* sprite);
+
+		template <class World, class Screen>
+		void SubmitTexture(World&& world, Screen&& screen);
+
+		bool IsScreenRectVisible(const vf2d& min, const vf2d& max) const;
+
+		// Returns true if the primitive with the screen space bounds was culled or drawn as a splat
+		bool CullPrimitive(const vf2d& min, const vf2d& max, const Pixel& col);
+		bool CullModel(const std::vector<vf2d>& modelCoordinates, const mat3& transform, const Pixel& col);
+
 	private:
 		vf2d m_Offset;
 		vf2d m_Scale;
 		vf2d m_PanPrev;
 
+		Sprite::SampleMethod m_SampleMethod;
+		bool m_UseViewTransform;
+		float m_SplatThreshold;
+
 		GameEngine* m_Engine;
 
 	};
@@ -153,6 +194,9 @@ namespace def
 	AffineTransforms::AffineTransforms()
 	{
 		m_Scale = { 1.0f, 1.0f };
+		m_SampleMethod = Sprite::SampleMethod::LINEAR;
+		m_UseViewTransform = false;
+		m_SplatThreshold = 1.0f;
 		m_Engine = GameEngine::s_Engine;
 	}
 
@@ -166,6 +210,11 @@ namespace def
 		return m_Offset;
 	}
 
+	mat3 AffineTransforms::GetTransform() const
+	{
+		return mat3::scale(m_Scale) * mat3::translate(-m_Offset);
+	}
+
 	vf2d AffineTransforms::GetOrigin()
 	{
 		return ScreenToWorld({ 0, 0 });
@@ -215,10 +264,114 @@ namespace def
 
 	bool AffineTransforms::IsRectVisible(const vf2d& pos, const vf2d& size)
 	{
-		vf2d p = WorldToScreen(pos);
-		vf2d s = size * m_Scale;
+		vf2d p1 = WorldToScreen(pos);
+		vf2d p2 = WorldToScreen(pos + size);
+
+		return IsScreenRectVisible(p1.min(p2), p1.max(p2));
+	}
+
+	void AffineTransforms::SetSampleMethod(Sprite::SampleMethod sampleMethod)
+	{
+		m_SampleMethod = sampleMethod;
+	}
+
+	Sprite::SampleMethod AffineTransforms::GetSampleMethod() const
+	{
+		return m_SampleMethod;
+	}
+
+	void AffineTransforms::UseViewTransform(bool enable)
+	{
+		m_UseViewTransform = enable;
+	}
 
-		return p.x + s.x >= 0.0f && p.y + s.y >= 0.0f && p.x < m_Engine->ScreenWidth() && p.y < m_Engine->ScreenHeight();
+	bool AffineTransforms::IsViewTransformUsed() const
+	{
+		return m_UseViewTransform;
+	}
+
+	template <class World, class Screen>
+	void AffineTransforms::SubmitTexture(World&& world, Screen&& screen)
+	{
+		if (!m_UseViewTransform)
+		{
+			screen();
+			return;
+		}
+
+		// The caller can have its own view transform set
+		mat3 previous = m_Engine->GetViewTransform();
+		bool wasUsed = m_Engine->IsViewTransformUsed();
+
+		m_Engine->SetViewTransform(GetTransform());
+		m_Engine->UseViewTransform(true);
+
+		world();
+
+		m_Engine->SetViewTransform(previous);
+		m_Engine->UseViewTransform(wasUsed);
+	}
+
+	void AffineTransforms::SetSplatThreshold(float threshold)
+	{
+		m_SplatThreshold = threshold;
+	}
+
+	float AffineTransforms::GetSplatThreshold() const
+	{
+		return m_SplatThreshold;
+	}
+
+	bool AffineTransforms::IsScreenRectVisible(const vf2d& min, const vf2d& max) const
+	{
+		return max.x >= 0.0f && max.y >= 0.0f && min.x < m_Engine->ScreenWidth() && min.y < m_Engine->ScreenHeight();
+	}
+
+	bool AffineTransforms::CullPrimitive(const vf2d& min, const vf2d& max, const Pixel& col)
+	{
+		if (!IsScreenRectVisible(min, max))
+			return true;
+
+		vf2d size = max - min;
+
+		// When zoomed out the cost stays proportional to the covered pixels instead of the rasterized shapes
+		if (size.x < m_SplatThreshold && size.y < m_SplatThreshold)
+		{
+			m_Engine->Draw((min + max) * 0.5f, col);
+			return true;
+		}
+
+		return false;
+	}
+
+	bool AffineTransforms::CullModel(const std::vector<vf2d>& modelCoordinates, const mat3& transform, const Pixel& col)
+	{
+		if (modelCoordinates.empty())
+			return true;
+
+		vf2d min = modelCoordinates[0];
+		vf2d max = modelCoordinates[0];
+
+		for (const vf2d& p : modelCoordinates)
+		{
+			min = min.min(p);
+			max = max.max(p);
+		}
+
+		// Bounds of the transformed local bounding box
+		vf2d corners[4] = { min, { max.x, min.y }, max, { min.x, max.y } };
+		transform.transform(corners, corners, 4);
+
+		min = corners[0];
+		max = corners[0];
+
+		for (const vf2d& p : corners)
+		{
+			min = min.min(p);
+			max = max.max(p);
+		}
+
+		return CullPrimitive(min, max, col);
 	}
 
 	bool AffineTransforms::Draw(const vi2d& pos, Pixel col)
@@ -233,7 +386,11 @@ namespace def
 
 	void AffineTransforms::DrawLine(const vi2d& pos1, const vi2d& pos2, const Pixel& col)
 	{
-		m_Engine->DrawLine(WorldToScreen(pos1), WorldToScreen(pos2), col);
+		vf2d p1 = WorldToScreen(pos1);
+		vf2d p2 = WorldToScreen(pos2);
+
+		if (!CullPrimitive(p1.min(p2), p1.max(p2), col))
+			m_Engine->DrawLine(p1, p2, col);
 	}
 
 	void AffineTransforms::DrawLine(int x1, int y1, int x2, int y2, const Pixel& col)
@@ -243,7 +400,12 @@ namespace def
 
 	void AffineTransforms::DrawTriangle(const vi2d& pos1, const vi2d& pos2, const vi2d& pos3, const Pixel& col)
 	{
-		m_Engine->DrawTriangle(WorldToScreen(pos1), WorldToScreen(pos2), WorldToScreen(pos3), col);
+		vf2d p1 = WorldToScreen(pos1);
+		vf2d p2 = WorldToScreen(pos2);
+		vf2d p3 = WorldToScreen(pos3);
+
+		if (!CullPrimitive(p1.min(p2).min(p3), p1.max(p2).max(p3), col))
+			m_Engine->DrawTriangle(p1, p2, p3, col);
 	}
 
 	void AffineTransforms::DrawTriangle(int x1, int y1, int x2, int y2, int x3, int y3, const Pixel& col)
@@ -253,7 +415,12 @@ namespace def
 
 	void AffineTransforms::FillTriangle(const vi2d& pos1, const vi2d& pos2, const vi2d& pos3, const Pixel& col)
 	{
-		m_Engine->FillTriangle(WorldToScreen(pos1), WorldToScreen(pos2), WorldToScreen(pos3), col);
+		vf2d p1 = WorldToScreen(pos1);
+		vf2d p2 = WorldToScreen(pos2);
+		vf2d p3 = WorldToScreen(pos3);
+
+		if (!CullPrimitive(p1.min(p2).min(p3), p1.max(p2).max(p3), col))
+			m_Engine->FillTriangle(p1, p2, p3, col);
 	}
 
 	void AffineTransforms::FillTriangle(int x1, int y1, int x2, int y2, int x3, int y3, const Pixel& col)
@@ -263,7 +430,11 @@ namespace def
 
 	void AffineTransforms::DrawRectangle(const vi2d& pos, const vi2d& size, const Pixel& col)
 	{
-		m_Engine->DrawRectangle(WorldToScreen(pos), size * m_Scale, col);
+		vf2d p1 = WorldToScreen(pos);
+		vf2d p2 = WorldToScreen(pos + size);
+
+		if (!CullPrimitive(p1.min(p2), p1.max(p2), col))
+			m_Engine->DrawRectangle(p1, size * m_Scale, col);
 	}
 
 	void AffineTransforms::DrawRectangle(int x, int y, int sizeX, int sizeY, const Pixel& col)
@@ -273,7 +444,17 @@ namespace def
 
 	void AffineTransforms::FillRectangle(const vi2d& pos, const vi2d& size, const Pixel& col)
 	{
-		m_Engine->FillRectangle(WorldToScreen(pos), size * m_Scale, col);
+		vf2d p1 = WorldToScreen(pos);
+		vf2d p2 = WorldToScreen(pos + size);
+
+		if (CullPrimitive(p1.min(p2), p1.max(p2), col))
+			return;
+
+		// Only the visible part is filled so zooming in doesn't cost more than the screen
+		vi2d start = vi2d(p1.min(p2)).max({ 0, 0 });
+		vi2d end = vi2d(p1.max(p2)).min(m_Engine->GetScreenSize());
+
+		m_Engine->FillRectangle(start, end - start, col);
 	}
 
 	void AffineTransforms::FillRectangle(int x, int y, int sizeX, int sizeY, const Pixel& col)
@@ -283,7 +464,11 @@ namespace def
 
 	void AffineTransforms::DrawCircle(const vi2d& pos, int radius, const Pixel& col)
 	{
-		m_Engine->DrawCircle(WorldToScreen(pos), (float)radius * m_Scale.x, col);
+		vf2d centre = WorldToScreen(pos);
+		float r = (float)radius * std::abs(m_Scale.x);
+
+		if (!CullPrimitive(centre - r, centre + r, col))
+			m_Engine->DrawCircle(centre, r, col);
 	}
 
 	void AffineTransforms::DrawCircle(int x, int y, int radius, const Pixel& col)
@@ -293,7 +478,11 @@ namespace def
 
 	void AffineTransforms::FillCircle(const vi2d& pos, int radius, const Pixel& col)
 	{
-		m_Engine->FillCircle(WorldToScreen(pos), (float)radius * m_Scale.x, col);
+		vf2d centre = WorldToScreen(pos);
+		float r = (float)radius * std::abs(m_Scale.x);
+
+		if (!CullPrimitive(centre - r, centre + r, col))
+			m_Engine->FillCircle(centre, r, col);
 	}
 
 	void AffineTransforms::FillCircle(int x, int y, int radius, const Pixel& col)
@@ -303,7 +492,11 @@ namespace def
 
 	void AffineTransforms::DrawEllipse(const vi2d& pos, const vi2d& size, const Pixel& col)
 	{
-		m_Engine->DrawEllipse(WorldToScreen(pos), size * m_Scale, col);
+		vf2d p1 = WorldToScreen(pos);
+		vf2d p2 = WorldToScreen(pos + size);
+
+		if (!CullPrimitive(p1.min(p2), p1.max(p2), col))
+			m_Engine->DrawEllipse(p1, size * m_Scale, col);
 	}
 
 	void AffineTransforms::DrawEllipse(int x, int y, int sizeX, int sizeY, const Pixel& col)
@@ -313,7 +506,11 @@ namespace def
 
 	void AffineTransforms::FillEllipse(const vi2d& pos, const vi2d& size, const Pixel& col)
 	{
-		m_Engine->FillEllipse(WorldToScreen(pos), size * m_Scale, col);
+		vf2d p1 = WorldToScreen(pos);
+		vf2d p2 = WorldToScreen(pos + size);
+
+		if (!CullPrimitive(p1.min(p2), p1.max(p2), col))
+			m_Engine->FillEllipse(p1, size * m_Scale, col);
 	}
 
 	void AffineTransforms::FillEllipse(int x, int y, int sizeX, int sizeY, const Pixel& col)
@@ -323,26 +520,7 @@ namespace def
 
 	void AffineTransforms::DrawSprite(const vi2d& pos, const Sprite* sprite)
 	{
-		vf2d size = vf2d(sprite->size) * m_Scale;
-
-		if (IsRectVisible(pos, sprite->size))
-		{
-			vi2d spriteStart = WorldToScreen(pos);
-			vi2d spriteEnd = WorldToScreen(pos + sprite->size);
-
-			vi2d screenStart = spriteStart.max({ 0, 0 });
-			vi2d screenEnd = spriteEnd.min(m_Engine->GetScreenSize());
-
-			vf2d step = 1.0f / size;
-
-			vi2d pixel;
-			for (pixel.y = screenStart.y; pixel.y < screenEnd.y; pixel.y++)
-				for (pixel.x = screenStart.x; pixel.x < screenEnd.x; pixel.x++)
-				{
-					vf2d sampled = vf2d(pixel - spriteStart) * step;
-					m_Engine->Draw(pixel, sprite->Sample(sampled, Sprite::SampleMethod::LINEAR, Sprite::WrapMethod::NONE));
-				}
-		}
+		BlitSprite(pos, { 0, 0 }, sprite->size, sprite);
 	}
 
 	void AffineTransforms::DrawSprite(int x, int y, const Sprite* sprite)
@@ -352,24 +530,7 @@ namespace def
 
 	void AffineTransforms::DrawPartialSprite(const vi2d& pos, const vi2d& filePos, const vi2d& fileSize, const Sprite* sprite)
 	{
-		vf2d size = sprite->size * m_Scale;
-
-		if (IsRectVisible(pos, size))
-		{
-			vf2d spriteStep = 1.0f / sprite->size;
-			vf2d screenStep = 1.0f / size;
-
-			vi2d start = WorldToScreen(pos);
-			vi2d end = start + size;
-
-			vi2d pixel;
-			for (pixel.y = start.y; pixel.y < end.y; pixel.y++)
-				for (pixel.x = start.x; pixel.x < end.x; pixel.x++)
-				{
-					vf2d sampled = (vf2d(pixel - start) * screenStep * vf2d(size) + vf2d(filePos)) * spriteStep;
-					m_Engine->Draw(pixel, sprite->Sample(sampled, Sprite::SampleMethod::LINEAR, Sprite::WrapMethod::NONE));
-				}
-		}
+		BlitSprite(pos, filePos, fileSize, sprite);
 	}
 
 	void AffineTransforms::DrawPartialSprite(int x, int y, int fileX, int fileY, int fileSizeX, int fileSizeY, const Sprite* sprite)
@@ -384,7 +545,10 @@ namespace def
 		std::transform(modelCoordinates.begin(), modelCoordinates.end(), transformed.begin(),
 			[&](const vf2d& p) { return p * m_Scale; });
 
-		m_Engine->DrawWireFrameModel(transformed, WorldToScreen(pos), rotation, scale, col);
+		vf2d screenPos = WorldToScreen(pos);
+
+		if (!CullModel(transformed, mat3::translate(screenPos) * mat3::rotate(rotation) * mat3::scale({ scale, scale }), col))
+			m_Engine->DrawWireFrameModel(transformed, screenPos, rotation, scale, col);
 	}
 
 	void AffineTransforms::DrawWireFrameModel(const std::vector<vf2d>& modelCoordinates, float x, float y, float rotation, float scale, const Pixel& col)
@@ -399,7 +563,10 @@ namespace def
 		std::transform(modelCoordinates.begin(), modelCoordinates.end(), transformed.begin(),
 			[&](const vf2d& p) { return p * m_Scale; });
 
-		m_Engine->FillWireFrameModel(transformed, WorldToScreen(pos), rotation, scale, col);
+		vf2d screenPos = WorldToScreen(pos);
+
+		if (!CullModel(transformed, mat3::translate(screenPos) * mat3::rotate(rotation) * mat3::scale({ scale, scale }), col))
+			m_Engine->FillWireFrameModel(transformed, screenPos, rotation, scale, col);
 	}
 
 	void AffineTransforms::FillWireFrameModel(const std::vector<vf2d>& modelCoordinates, float x, float y, float rotation, float scale, const Pixel& col)
@@ -407,44 +574,140 @@ namespace def
 		FillWireFrameModel(modelCoordinates, { x, y }, rotation, scale, col);
 	}
 
+	void AffineTransforms::DrawWireFrameModel(const std::vector<vf2d>& modelCoordinates, const mat3& transform, const Pixel& col)
+	{
+		mat3 toScreen = GetTransform() * transform;
+
+		if (!CullModel(modelCoordinates, toScreen, col))
+			m_Engine->DrawWireFrameModel(modelCoordinates, toScreen, col);
+	}
+
+	void AffineTransforms::FillWireFrameModel(const std::vector<vf2d>& modelCoordinates, const mat3& transform, const Pixel& col)
+	{
+		mat3 toScreen = GetTransform() * transform;
+
+		if (!CullModel(modelCoordinates, toScreen, col))
+			m_Engine->FillWireFrameModel(modelCoordinates, toScreen, col);
+	}
+
 	void AffineTransforms::DrawTexture(const vf2d& pos, const Texture* tex, const vf2d& scale, const Pixel& tint)
 	{
-		m_Engine->DrawTexture(WorldToScreen(pos), tex, scale * m_Scale, tint);
+		if (!IsRectVisible(pos, tex->size * scale))
+			return;
+
+		SubmitTexture(
+			[&]()
+			{
+				m_Engine->DrawTexture(pos, tex, scale, tint);
+			},
+			[&]()
+			{
+				m_Engine->DrawTexture(WorldToScreen(pos), tex, scale * m_Scale, tint);
+			});
 	}
 
 	void AffineTransforms::DrawPartialTexture(const vf2d& pos, const Texture* tex, const vf2d& filePos, const vf2d& fileSize, const vf2d& scale, const Pixel& tint)
 	{
-		m_Engine->DrawPartialTexture(WorldToScreen(pos), tex, filePos, fileSize, scale * m_Scale, tint);
+		if (!IsRectVisible(pos, fileSize * scale))
+			return;
+
+		SubmitTexture(
+			[&]()
+			{
+				m_Engine->DrawPartialTexture(pos, tex, filePos, fileSize, scale, tint);
+			},
+			[&]()
+			{
+				m_Engine->DrawPartialTexture(WorldToScreen(pos), tex, filePos, fileSize, scale * m_Scale, tint);
+			});
 	}
 
 	void AffineTransforms::DrawWarpedTexture(const std::vector<vf2d>& points, const Texture* tex, const Pixel& tint)
 	{
-		std::vector<vf2d> transformed(points.size());
+		SubmitTexture(
+			[&]()
+			{
+				m_Engine->DrawWarpedTexture(points, tex, tint);
+			},
+			[&]()
+			{
+				std::vector<vf2d> transformed(points.size());
 
-		std::transform(points.begin(), points.end(), transformed.begin(),
-			[&](const vf2d& p) { return WorldToScreen(p); });
+				std::transform(points.begin(), points.end(), transformed.begin(),
+					[&](const vf2d& p) { return WorldToScreen(p); });
 
-		m_Engine->DrawWarpedTexture(transformed, tex, tint);
+				m_Engine->DrawWarpedTexture(transformed, tex, tint);
+			});
 	}
 
 	void AffineTransforms::DrawRotatedTexture(const vf2d& pos, const Texture* tex, float rotation, const vf2d& center, const vf2d& scale, const Pixel& tint)
 	{
-		m_Engine->DrawRotatedTexture(WorldToScreen(pos), tex, rotation, center, scale * m_Scale, tint);
+		SubmitTexture(
+			[&]()
+			{
+				m_Engine->DrawRotatedTexture(pos, tex, rotation, center, scale, tint);
+			},
+			[&]()
+			{
+				m_Engine->DrawRotatedTexture(WorldToScreen(pos), tex, rotation, center, scale * m_Scale, tint);
+			});
 	}
 
 	void AffineTransforms::DrawPartialRotatedTexture(const vf2d& pos, const Texture* tex, const vf2d& filePos, const vf2d& fileSize, float rotation, const vf2d& center, const vf2d& scale, const Pixel& tint)
 	{
-		m_Engine->DrawPartialRotatedTexture(WorldToScreen(pos), tex, filePos, fileSize, rotation, center, scale * m_Scale, tint);
+		SubmitTexture(
+			[&]()
+			{
+				m_Engine->DrawPartialRotatedTexture(pos, tex, filePos, fileSize, rotation, center, scale, tint);
+			},
+			[&]()
+			{
+				m_Engine->DrawPartialRotatedTexture(WorldToScreen(pos), tex, filePos, fileSize, rotation, center, scale * m_Scale, tint);
+			});
+	}
+
+	void AffineTransforms::DrawTexture(const mat3& transform, const Texture* tex, const Pixel& tint)
+	{
+		SubmitTexture(
+			[&]()
+			{
+				m_Engine->DrawTexture(transform, tex, tint);
+			},
+			[&]()
+			{
+				m_Engine->DrawTexture(GetTransform() * transform, tex, tint);
+			});
+	}
+
+	void AffineTransforms::DrawPartialTexture(const mat3& transform, const Texture* tex, const vf2d& filePos, const vf2d& fileSize, const Pixel& tint)
+	{
+		SubmitTexture(
+			[&]()
+			{
+				m_Engine->DrawPartialTexture(transform, tex, filePos, fileSize, tint);
+			},
+			[&]()
+			{
+				m_Engine->DrawPartialTexture(GetTransform() * transform, tex, filePos, fileSize, tint);
+			});
 	}
 
 	void AffineTransforms::DrawTexturePolygon(const std::vector<vf2d>& verts, const std::vector<Pixel>& cols, Texture::Structure structure)
 	{
-		std::vector<vf2d> transformed(verts.size());
+		SubmitTexture(
+			[&]()
+			{
+				m_Engine->DrawTexturePolygon(verts, cols, structure);
+			},
+			[&]()
+			{
+				std::vector<vf2d> transformed(verts.size());
 
-		std::transform(verts.begin(), verts.end(), transformed.begin(),
-			[&](const vf2d& p) { return WorldToScreen(p); });
+				std::transform(verts.begin(), verts.end(), transformed.begin(),
+					[&](const vf2d& p) { return WorldToScreen(p); });
 
-		m_Engine->DrawTexturePolygon(transformed, cols, structure);
+				m_Engine->DrawTexturePolygon(transformed, cols, structure);
+			});
 	}
 
 	void AffineTransforms::DrawTextureLine(const vi2d& pos1, const vi2d& pos2, const Pixel& col)
@@ -474,30 +737,223 @@ namespace def
 
 	void AffineTransforms::DrawTextureCircle(const vi2d& pos, int radius, const Pixel& col)
 	{
-		m_Engine->DrawTextureCircle(WorldToScreen(pos), int((float)radius * m_Scale.x), col);
+		if (!IsRectVisible(pos - radius, vi2d(radius, radius) * 2))
+			return;
+
+		SubmitTexture(
+			[&]()
+			{
+				m_Engine->DrawTextureCircle(pos, radius, col);
+			},
+			[&]()
+			{
+				m_Engine->DrawTextureCircle(WorldToScreen(pos), int((float)radius * m_Scale.x), col);
+			});
 	}
 
 	void AffineTransforms::FillTextureCircle(const vi2d& pos, int radius, const Pixel& col)
 	{
-		m_Engine->FillTextureCircle(WorldToScreen(pos), int((float)radius * m_Scale.x), col);
+		if (!IsRectVisible(pos - radius, vi2d(radius, radius) * 2))
+			return;
+
+		SubmitTexture(
+			[&]()
+			{
+				m_Engine->FillTextureCircle(pos, radius, col);
+			},
+			[&]()
+			{
+				m_Engine->FillTextureCircle(WorldToScreen(pos), int((float)radius * m_Scale.x), col);
+			});
 	}
 
 	void AffineTransforms::GradientTextureTriangle(const vi2d& pos1, const vi2d& pos2, const vi2d& pos3, const Pixel& col1, const Pixel& col2, const Pixel& col3)
 	{
-		m_Engine->GradientTextureTriangle(
-			WorldToScreen(pos1), WorldToScreen(pos2), WorldToScreen(pos3),
-			col1, col2, col3
-		);
+		SubmitTexture(
+			[&]()
+			{
+				m_Engine->GradientTextureTriangle(pos1, pos2, pos3, col1, col2, col3);
+			},
+			[&]()
+			{
+				m_Engine->GradientTextureTriangle(
+					WorldToScreen(pos1), WorldToScreen(pos2), WorldToScreen(pos3),
+					col1, col2, col3
+				);
+			});
 	}
 
 	void AffineTransforms::GradientTextureRectangle(const vi2d& pos, const vi2d& size, const Pixel& colTL, const Pixel& colTR, const Pixel& colBR, const Pixel& colBL)
 	{
-		m_Engine->GradientTextureRectangle(WorldToScreen(pos), size * m_Scale, colTL, colTR, colBR, colBL);
+		SubmitTexture(
+			[&]()
+			{
+				m_Engine->GradientTextureRectangle(pos, size, colTL, colTR, colBR, colBL);
+			},
+			[&]()
+			{
+				m_Engine->GradientTextureRectangle(WorldToScreen(pos), size * m_Scale, colTL, colTR, colBR, colBL);
+			});
 	}
 
 	void AffineTransforms::DrawTextureString(const vi2d& pos, std::string_view text, const Pixel& col, const vf2d& scale)
 	{
-		m_Engine->DrawTextureString(WorldToScreen(pos), text, col, scale * m_Scale);
+		SubmitTexture(
+			[&]()
+			{
+				m_Engine->DrawTextureString(pos, text, col, scale);
+			},
+			[&]()
+			{
+				m_Engine->DrawTextureString(WorldToScreen(pos), text, col, scale * m_Scale);
+			});
+	}
+
+	void AffineTransforms::BlitSprite(const vf2d& pos, const vi2d& filePos, const vi2d& fileSize, const Sprite* sprite)
+	{
+		Graphic* drawTarget = m_Engine->GetDrawTarget();
+
+		if (!sprite || !drawTarget || fileSize.x <= 0 || fileSize.y <= 0)
+			return;
+
+		Sprite* target = drawTarget->sprite;
+
+		// Only the part of the source rectangle that is inside of the sprite is drawn
+		vi2d fileFirst = filePos.max({ 0, 0 });
+		vi2d fileEnd = (filePos + fileSize).min(sprite->size) - 1;
+
+		if (fileFirst.x > fileEnd.x || fileFirst.y > fileEnd.y)
+			return;
+
+		// The texels are mapped by the whole rectangle
+		vf2d start = WorldToScreen(pos);
+		vf2d end = WorldToScreen(pos + fileSize);
+
+		vf2d clippedStart = WorldToScreen(pos + (fileFirst - filePos));
+		vf2d clippedEnd = WorldToScreen(pos + (fileEnd + 1 - filePos));
+
+		// A pixel is drawn if its centre is inside of the rectangle, with a negative
+		// scale the end is on the left or above the start and the source is walked backwards
+		vi2d first = (clippedStart.min(clippedEnd) - 0.5f).ceil();
+		vi2d last = (clippedStart.max(clippedEnd) - 0.5f).ceil();
+
+		first = first.max({ 0, 0 });
+		last = last.min(target->size);
+
+		if (first.x >= last.x || first.y >= last.y)
+			return;
+
+		// 16.16 fixed point texel coordinates of the centres of the destination pixels
+		constexpr int SHIFT = 16;
+		constexpr int64_t ONE = 1ll << SHIFT;
+
+		vf2d texelsPerPixel = vf2d(fileSize) / (end - start);
+
+		int64_t stepX = int64_t(texelsPerPixel.x * ONE);
+		int64_t stepY = int64_t(texelsPerPixel.y * ONE);
+
+		int64_t startU = int64_t(((float(first.x) + 0.5f - start.x) * texelsPerPixel.x + filePos.x) * ONE);
+		int64_t startV = int64_t(((float(first.y) + 0.5f - start.y) * texelsPerPixel.y + filePos.y) * ONE);
+
+		// The rest of the modes need the destination pixel or the shader so they go through the engine
+		Pixel::Mode pixelMode = m_Engine->GetPixelMode();
+		bool isDirect = pixelMode == Pixel::Mode::DEFAULT || pixelMode == Pixel::Mode::MASK;
+
+		// Draw counts the pixels itself so only the direct writes are counted here
+		uint64_t written = 0;
+
+		auto Plot = [&](int x, int y, const Pixel& col)
+			{
+				if (!isDirect)
+					m_Engine->Draw(x, y, col);
+				else if (pixelMode == Pixel::Mode::DEFAULT || col.a == 255)
+				{
+					target->pixels[y * target->size.x + x] = col;
+					written++;
+				}
+			};
+
+		switch (m_SampleMethod)
+		{
+		case Sprite::SampleMethod::LINEAR:
+		{
+			int64_t v = startV;
+
+			for (int y = first.y; y < last.y; y++, v += stepY)
+			{
+				int sy = std::clamp(int(v >> SHIFT), fileFirst.y, fileEnd.y);
+				const Pixel* row = &sprite->pixels[sy * sprite->size.x];
+
+				int64_t u = startU;
+
+				for (int x = first.x; x < last.x; x++, u += stepX)
+					Plot(x, y, row[std::clamp(int(u >> SHIFT), fileFirst.x, fileEnd.x)]);
+			}
+		}
+		break;
+
+		case Sprite::SampleMethod::BILINEAR:
+		{
+			// The texel centres are at .5 so the samples are shifted by half of a texel
+			int64_t v = startV - ONE / 2;
+
+			for (int y = first.y; y < last.y; y++, v += stepY)
+			{
+				int y0 = int(v >> SHIFT);
+				uint32_t fy = uint32_t((v >> (SHIFT - 8)) & 0xFF);
+
+				const Pixel* row0 = &sprite->pixels[std::clamp(y0, fileFirst.y, fileEnd.y) * sprite->size.x];
+				const Pixel* row1 = &sprite->pixels[std::clamp(y0 + 1, fileFirst.y, fileEnd.y) * sprite->size.x];
+
+				int64_t u = startU - ONE / 2;
+
+				for (int x = first.x; x < last.x; x++, u += stepX)
+				{
+					int x0 = int(u >> SHIFT);
+					uint32_t fx = uint32_t((u >> (SHIFT - 8)) & 0xFF);
+
+					int sx0 = std::clamp(x0, fileFirst.x, fileEnd.x);
+					int sx1 = std::clamp(x0 + 1, fileFirst.x, fileEnd.x);
+
+					Pixel tl = row0[sx0], tr = row0[sx1];
+					Pixel bl = row1[sx0], br = row1[sx1];
+
+					Pixel col;
+
+					for (int i = 0; i < 4; i++)
+					{
+						uint32_t top = tl.rgba_v[i] * (256 - fx) + tr.rgba_v[i] * fx;
+						uint32_t bottom = bl.rgba_v[i] * (256 - fx) + br.rgba_v[i] * fx;
+
+						col.rgba_v[i] = uint8_t((top * (256 - fy) + bottom * fy) >> 16);
+					}
+
+					Plot(x, y, col);
+				}
+			}
+		}
+		break;
+
+		default:
+		{
+			// Only the visible pixels are sampled but every sample goes through the sprite
+			vf2d invSize = 1.0f / vf2d(sprite->size);
+
+			for (int y = first.y; y < last.y; y++)
+				for (int x = first.x; x < last.x; x++)
+				{
+					vf2d texel = (vf2d(float(x), float(y)) + 0.5f - start) * texelsPerPixel + filePos;
+					Plot(x, y, sprite->Sample(texel * invSize, m_SampleMethod, Sprite::WrapMethod::CLAMP));
+				}
+		}
+
+		}
+
+#ifdef DGE_FRAME_STATS
+		m_Engine->AddPixelsWritten(written);
+#else
+		UNUSED(written);
+#endif
 	}
 
 	vf2d AffineTransforms::ScreenToWorld(const vf2d& pos) const
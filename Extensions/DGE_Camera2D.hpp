@@ -66,6 +66,7 @@ namespace def
 
 		Mode GetMode() const;
 		vf2d GetPosition() const;
+		vf2d GetViewArea() const;
 
 	private:
 		Mode m_Mode;
@@ -132,6 +133,11 @@ namespace def
 	{
 		return m_Position;
 	}
+
+	vf2d Camera2D::GetViewArea() const
+	{
+		return m_ViewArea;
+	}
 }
 
 #endif
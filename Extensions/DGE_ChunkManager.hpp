@@ -0,0 +1,454 @@
+#ifndef DGE_CHUNK_MANAGER_HPP
+#define DGE_CHUNK_MANAGER_HPP
+
+#pragma region License
+/*
+*	BSD 3-Clause License
+
+	Copyright (c) 2022 - 2024, Alex
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma endregion
+
+#pragma region Includes
+
+#include <algorithm>
+#include <functional>
+#include <list>
+#include <unordered_map>
+
+#include "defGameEngine.hpp"
+#include "DGE_Camera2D.hpp"
+
+#pragma endregion
+
+namespace def
+{
+	/*
+	* Keeps the chunks of an unbounded world around the view loaded,
+	* the chunks are generated or loaded by the loader on the thread pool
+	* and are kept in an LRU cache that evicts the chunks that weren't
+	* requested for the longest time once they use more memory than the limit
+	*/
+	template <class T>
+	class ChunkManager
+	{
+	public:
+		// Called on a worker thread, fills the chunk at the coordinate
+		// and returns the number of bytes that the chunk uses
+		using Loader = std::function<size_t(const vi2d& coord, T& chunk)>;
+
+		ChunkManager() = default;
+		ChunkManager(const vf2d& chunkSize, const Loader& loader, size_t memoryLimit, ThreadPool* pool = nullptr);
+		~ChunkManager();
+
+		// The cache keeps iterators into its own lists
+		ChunkManager(const ChunkManager&) = delete;
+		ChunkManager& operator=(const ChunkManager&) = delete;
+
+		// If the pool is nullptr then the chunks are loaded by Update on the calling thread
+		void Initialise(const vf2d& chunkSize, const Loader& loader, size_t memoryLimit, ThreadPool* pool = nullptr);
+
+		// Requests the chunks that overlap the view extended by the margin,
+		// moves the loaded ones into the cache and evicts the old ones
+		void Update(const vf2d& viewPos, const vf2d& viewSize);
+		void Update(const Camera2D& camera);
+
+		// In chunks around the view
+		void SetMargin(int margin);
+
+		// The requested chunks are never evicted so the usage can be over the limit
+		// if the view and the margin cover more chunks than fit in it
+		void SetMemoryLimit(size_t bytes);
+
+		// nullptr if the chunk isn't loaded yet
+		T* GetChunk(const vi2d& coord);
+		bool IsLoaded(const vi2d& coord) const;
+
+		// The loaded chunks that overlap the view, row by row
+		const std::vector<vi2d>& GetVisibleChunks() const;
+
+		vi2d WorldToChunk(const vf2d& pos) const;
+		vf2d ChunkToWorld(const vi2d& coord) const;
+
+		size_t GetLoadedCount() const;
+		size_t GetLoadingCount() const;
+		size_t GetMemoryUsage() const;
+		vf2d GetChunkSize() const;
+
+	private:
+		struct Slot
+		{
+			T data;
+			size_t size = 0;
+
+			std::atomic<bool> isReady = false;
+			std::atomic<bool> isCancelled = false;
+
+			ThreadPool::TaskHandle task;
+		};
+
+		struct Entry
+		{
+			std::shared_ptr<Slot> slot;
+			std::list<vi2d>::iterator usage;
+
+			// Set once the chunk is in the cache and its memory is counted
+			bool isLoaded = false;
+		};
+
+		struct CoordHash
+		{
+			size_t operator()(const vi2d& coord) const;
+		};
+
+	private:
+		void Request(const vi2d& coord);
+		void Erase(const vi2d& coord);
+
+	private:
+		vf2d m_ChunkSize;
+		Loader m_Loader;
+
+		ThreadPool* m_Pool = nullptr;
+
+		size_t m_MemoryLimit = 0;
+		size_t m_MemoryUsage = 0;
+
+		int m_Margin = 1;
+
+		std::unordered_map<vi2d, Entry, CoordHash> m_Chunks;
+
+		// The most recently requested chunks are at the front
+		std::list<vi2d> m_Usage;
+
+		std::vector<vi2d> m_Loading;
+		std::vector<vi2d> m_Visible;
+
+		// The cancelled loads that may still be running
+		std::vector<ThreadPool::TaskHandle> m_Cancelled;
+
+		vi2d m_RequestedMin;
+		vi2d m_RequestedMax;
+
+	};
+}
+
+#ifdef DGE_CHUNK_MANAGER
+#undef DGE_CHUNK_MANAGER
+
+namespace def
+{
+	template <class T>
+	size_t ChunkManager<T>::CoordHash::operator()(const vi2d& coord) const
+	{
+		return std::hash<uint64_t>()((uint64_t(uint32_t(coord.x)) << 32) | uint32_t(coord.y));
+	}
+
+	template <class T>
+	ChunkManager<T>::ChunkManager(const vf2d& chunkSize, const Loader& loader, size_t memoryLimit, ThreadPool* pool)
+	{
+		Initialise(chunkSize, loader, memoryLimit, pool);
+	}
+
+	template <class T>
+	ChunkManager<T>::~ChunkManager()
+	{
+		// The loader may use data that is destroyed with the owner of the manager
+		if (m_Pool)
+		{
+			for (const auto& coord : m_Loading)
+				m_Pool->Wait(m_Chunks[coord].slot->task);
+
+			for (const auto& task : m_Cancelled)
+				m_Pool->Wait(task);
+		}
+	}
+
+	template <class T>
+	void ChunkManager<T>::Initialise(const vf2d& chunkSize, const Loader& loader, size_t memoryLimit, ThreadPool* pool)
+	{
+		while (!m_Usage.empty())
+			Erase(m_Usage.back());
+
+		if (m_Pool)
+		{
+			for (const auto& task : m_Cancelled)
+				m_Pool->Wait(task);
+		}
+
+		m_Cancelled.clear();
+
+		m_ChunkSize = chunkSize;
+		m_Loader = loader;
+		m_MemoryLimit = memoryLimit;
+		m_Pool = pool;
+
+		m_MemoryUsage = 0;
+		m_Visible.clear();
+	}
+
+	template <class T>
+	void ChunkManager<T>::Update(const vf2d& viewPos, const vf2d& viewSize)
+	{
+		vi2d viewMin = WorldToChunk(viewPos);
+		vi2d viewMax = WorldToChunk(viewPos + viewSize);
+
+		m_RequestedMin = viewMin - vi2d(m_Margin, m_Margin);
+		m_RequestedMax = viewMax + vi2d(m_Margin, m_Margin);
+
+		auto IsRequested = [&](const vi2d& coord)
+			{
+				return coord.x >= m_RequestedMin.x && coord.y >= m_RequestedMin.y &&
+					coord.x <= m_RequestedMax.x && coord.y <= m_RequestedMax.y;
+			};
+
+		// The finished loads are moved into the cache and the ones that are
+		// out of the area now are cancelled before they start if possible
+		for (size_t i = 0; i < m_Loading.size(); )
+		{
+			vi2d coord = m_Loading[i];
+			Entry& entry = m_Chunks[coord];
+
+			if (entry.slot->isReady.load(std::memory_order_acquire))
+			{
+				entry.isLoaded = true;
+				m_MemoryUsage += entry.slot->size;
+			}
+			else if (!IsRequested(coord))
+			{
+				// Erase removes the coordinate from m_Loading
+				Erase(coord);
+				continue;
+			}
+			else
+			{
+				i++;
+				continue;
+			}
+
+			m_Loading[i] = m_Loading.back();
+			m_Loading.pop_back();
+		}
+
+		std::vector<vi2d> missing;
+
+		for (int y = m_RequestedMin.y; y <= m_RequestedMax.y; y++)
+			for (int x = m_RequestedMin.x; x <= m_RequestedMax.x; x++)
+			{
+				auto it = m_Chunks.find({ x, y });
+
+				if (it == m_Chunks.end())
+					missing.push_back({ x, y });
+				else
+					m_Usage.splice(m_Usage.begin(), m_Usage, it->second.usage);
+			}
+
+		// The chunks that are closer to the centre of the view are loaded first
+		vi2d centre = (viewMin + viewMax) / 2;
+
+		std::sort(missing.begin(), missing.end(),
+			[&](const vi2d& lhs, const vi2d& rhs)
+			{
+				return (lhs - centre).mag2() < (rhs - centre).mag2();
+			});
+
+		for (const auto& coord : missing)
+			Request(coord);
+
+		// The requested chunks are all at the front so the eviction stops at the first one
+		while (m_MemoryUsage > m_MemoryLimit && !m_Usage.empty() && !IsRequested(m_Usage.back()))
+			Erase(m_Usage.back());
+
+		for (size_t i = 0; i < m_Cancelled.size(); )
+		{
+			if (m_Cancelled[i]->isDone)
+			{
+				m_Cancelled[i] = m_Cancelled.back();
+				m_Cancelled.pop_back();
+			}
+			else
+				i++;
+		}
+
+		m_Visible.clear();
+
+		for (int y = viewMin.y; y <= viewMax.y; y++)
+			for (int x = viewMin.x; x <= viewMax.x; x++)
+			{
+				auto it = m_Chunks.find({ x, y });
+
+				if (it != m_Chunks.end() && it->second.isLoaded)
+					m_Visible.push_back({ x, y });
+			}
+	}
+
+	template <class T>
+	void ChunkManager<T>::Update(const Camera2D& camera)
+	{
+		Update(camera.GetPosition() - camera.GetViewArea() * 0.5f, camera.GetViewArea());
+	}
+
+	template <class T>
+	void ChunkManager<T>::SetMargin(int margin)
+	{
+		m_Margin = std::max(0, margin);
+	}
+
+	template <class T>
+	void ChunkManager<T>::SetMemoryLimit(size_t bytes)
+	{
+		m_MemoryLimit = bytes;
+	}
+
+	template <class T>
+	T* ChunkManager<T>::GetChunk(const vi2d& coord)
+	{
+		auto it = m_Chunks.find(coord);
+
+		if (it == m_Chunks.end() || !it->second.isLoaded)
+			return nullptr;
+
+		return &it->second.slot->data;
+	}
+
+	template <class T>
+	bool ChunkManager<T>::IsLoaded(const vi2d& coord) const
+	{
+		auto it = m_Chunks.find(coord);
+		return it != m_Chunks.end() && it->second.isLoaded;
+	}
+
+	template <class T>
+	const std::vector<vi2d>& ChunkManager<T>::GetVisibleChunks() const
+	{
+		return m_Visible;
+	}
+
+	template <class T>
+	vi2d ChunkManager<T>::WorldToChunk(const vf2d& pos) const
+	{
+		return (pos / m_ChunkSize).floor();
+	}
+
+	template <class T>
+	vf2d ChunkManager<T>::ChunkToWorld(const vi2d& coord) const
+	{
+		return vf2d(coord) * m_ChunkSize;
+	}
+
+	template <class T>
+	size_t ChunkManager<T>::GetLoadedCount() const
+	{
+		return m_Chunks.size() - m_Loading.size();
+	}
+
+	template <class T>
+	size_t ChunkManager<T>::GetLoadingCount() const
+	{
+		return m_Loading.size();
+	}
+
+	template <class T>
+	size_t ChunkManager<T>::GetMemoryUsage() const
+	{
+		return m_MemoryUsage;
+	}
+
+	template <class T>
+	vf2d ChunkManager<T>::GetChunkSize() const
+	{
+		return m_ChunkSize;
+	}
+
+	template <class T>
+	void ChunkManager<T>::Request(const vi2d& coord)
+	{
+		m_Usage.push_front(coord);
+
+		Entry& entry = m_Chunks[coord];
+		entry.usage = m_Usage.begin();
+		entry.slot = std::make_shared<Slot>();
+
+		if (!m_Pool)
+		{
+			entry.slot->size = m_Loader(coord, entry.slot->data);
+			entry.isLoaded = true;
+
+			m_MemoryUsage += entry.slot->size;
+			return;
+		}
+
+		std::weak_ptr<Slot> weakSlot = entry.slot;
+
+		/*
+		* The slot owns the task so the task only keeps a weak reference back to it,
+		* the loader is copied so it stays valid even if the chunk is evicted
+		*/
+		entry.slot->task = m_Pool->Schedule([weakSlot, coord, loader = m_Loader]()
+			{
+				std::shared_ptr<Slot> slot = weakSlot.lock();
+
+				if (!slot)
+					return;
+
+				if (!slot->isCancelled.load(std::memory_order_relaxed))
+					slot->size = loader(coord, slot->data);
+
+				slot->isReady.store(true, std::memory_order_release);
+			});
+
+		m_Loading.push_back(coord);
+	}
+
+	template <class T>
+	void ChunkManager<T>::Erase(const vi2d& coord)
+	{
+		auto it = m_Chunks.find(coord);
+		Entry& entry = it->second;
+
+		if (entry.isLoaded)
+			m_MemoryUsage -= entry.slot->size;
+		else
+		{
+			entry.slot->isCancelled.store(true, std::memory_order_relaxed);
+
+			if (!entry.slot->task->isDone)
+				m_Cancelled.push_back(entry.slot->task);
+
+			m_Loading.erase(std::find(m_Loading.begin(), m_Loading.end(), coord));
+		}
+
+		m_Usage.erase(entry.usage);
+		m_Chunks.erase(it);
+	}
+}
+
+#endif
+
+#endif
@@ -30,10 +30,14 @@
 
 #pragma region includes
 
+#include "defGameEngine.hpp"
+
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
 
+#include <algorithm>
+
 #pragma endregion
 
 #ifdef IMGUI_HAS_DOCK
@@ -56,6 +60,16 @@ namespace def
 		void Update();
 		void Draw();
 		void Destroy();
+
+		// Shows the engine's frame stats, must be called between Update and Draw once per frame
+		void DrawPerformanceWindow(GameEngine* engine, bool* open = nullptr);
+
+	private:
+		static constexpr int FRAME_HISTORY = 240;
+
+		// Frame times in milliseconds
+		float m_FrameTimes[FRAME_HISTORY] = {};
+		int m_FrameTimeOffset = 0;
 	};
 
 #ifdef DGE_DEARIMGUI
@@ -93,6 +107,8 @@ namespace def
 		// Setup Platform/Renderer backends
 		if (!ImGui_ImplGlfw_InitForOpenGL(window, true)) return false;
 		if (!ImGui_ImplOpenGL3_Init("#version 150")) return false;
+
+		return true;
 	}
 
 	void DearImGui::Update()
@@ -126,5 +142,72 @@ namespace def
 		ImGui_ImplGlfw_Shutdown();
 		ImGui::DestroyContext();
 	}
+
+	void DearImGui::DrawPerformanceWindow(GameEngine* engine, bool* open)
+	{
+		const FrameStats& stats = engine->GetFrameStats();
+
+		m_FrameTimes[m_FrameTimeOffset] = stats.frameTime * 1000.0f;
+		m_FrameTimeOffset = (m_FrameTimeOffset + 1) % FRAME_HISTORY;
+
+		if (!ImGui::Begin("Performance", open))
+		{
+			ImGui::End();
+			return;
+		}
+
+		float average = 0.0f;
+		float worst = 0.0f;
+
+		for (float time : m_FrameTimes)
+		{
+			average += time;
+			worst = std::max(worst, time);
+		}
+
+		average /= (float)FRAME_HISTORY;
+
+		char overlay[64];
+		snprintf(overlay, sizeof(overlay), "avg %.2f ms, max %.2f ms", average, worst);
+
+		ImGui::Text("%.2f ms (%.0f FPS)", stats.frameTime * 1000.0f, stats.frameTime > 0.0f ? 1.0f / stats.frameTime : 0.0f);
+		ImGui::PlotLines("##FrameTimes", m_FrameTimes, FRAME_HISTORY, m_FrameTimeOffset, overlay, 0.0f, worst * 1.2f, ImVec2(-1.0f, 80.0f));
+
+		if (ImGui::CollapsingHeader("Phases", ImGuiTreeNodeFlags_DefaultOpen))
+		{
+			ImGui::Text("Update: %.2f ms", stats.updateTime * 1000.0f);
+			ImGui::Text("Submit: %.2f ms", stats.submitTime * 1000.0f);
+			ImGui::Text("Render: %.2f ms", stats.renderTime * 1000.0f);
+		}
+
+		if (ImGui::CollapsingHeader("Rendering", ImGuiTreeNodeFlags_DefaultOpen))
+		{
+			ImGui::Text("Draw calls: %u", stats.drawCalls);
+			ImGui::Text("Texture instances: %u", stats.textureInstances);
+			ImGui::Text("Texture memory: %.2f MiB", (double)stats.textureMemory / (1024.0 * 1024.0));
+			ImGui::Text("Uploaded: %.2f KiB", (double)stats.uploadBytes / 1024.0);
+
+#ifdef DGE_FRAME_STATS
+			ImGui::Text("Pixels written: %llu", (unsigned long long)stats.pixelsWritten);
+#else
+			ImGui::TextDisabled("Pixels written: define DGE_FRAME_STATS");
+#endif
+		}
+
+		if (ImGui::CollapsingHeader("Settings", ImGuiTreeNodeFlags_DefaultOpen))
+		{
+			bool vsync = engine->IsVSync();
+
+			if (ImGui::Checkbox("VSync", &vsync))
+				engine->SetVSync(vsync);
+
+			float frameCap = engine->GetFrameCap();
+
+			if (ImGui::SliderFloat("Frame cap", &frameCap, 0.0f, 240.0f, frameCap > 0.0f ? "%.0f FPS" : "Off"))
+				engine->SetFrameCap(frameCap);
+		}
+
+		ImGui::End();
+	}
 #endif
 }
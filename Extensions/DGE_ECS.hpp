@@ -0,0 +1,927 @@
+#ifndef DGE_ECS_HPP
+#define DGE_ECS_HPP
+
+#pragma region License
+/*
+*	BSD 3-Clause License
+
+	Copyright (c) 2022 - 2024, Alex
+
+	Redistribution and use in source and binary forms, with or without
+	modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this
+	   list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice,
+	   this list of conditions and the following disclaimer in the documentation
+	   and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its
+	   contributors may be used to endorse or promote products derived from
+	   this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+	AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+	IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+	FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+	DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+	SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+	CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+	OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+	OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma endregion
+
+#pragma region Includes
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+
+#include "defGameEngine.hpp"
+
+#pragma endregion
+
+namespace def
+{
+	// The lower 32 bits are the index and the upper 32 bits are the generation
+	using Entity = uint64_t;
+	using ComponentId = uint32_t;
+
+	inline constexpr Entity NULL_ENTITY = ~Entity(0);
+
+	// Type erased operations of a component type
+	struct ComponentInfo
+	{
+		ComponentId id;
+
+		size_t size;
+		size_t alignment;
+
+		void (*moveConstruct)(void* dst, void* src);
+		void (*destroy)(void* ptr);
+
+		inline static std::atomic<ComponentId> s_NextId = 0;
+	};
+
+	// The ids are given on the first use so they can differ between runs
+	template <class T>
+	const ComponentInfo& GetComponentInfo();
+
+	template <class T>
+	ComponentId GetComponentId();
+
+	// True if none of the types is repeated
+	template <class... T>
+	struct AreUnique : std::true_type {};
+
+	template <class T, class... Rest>
+	struct AreUnique<T, Rest...> : std::bool_constant<(!std::is_same_v<T, Rest> && ...) && AreUnique<Rest...>::value> {};
+
+	/*
+	* Stores the entities that have the same set of components, every component
+	* is a column that is split into chunks of CHUNK_SIZE bytes, the rows are kept
+	* dense by moving the last row into the removed one
+	*/
+	struct Archetype
+	{
+		static constexpr size_t CHUNK_SIZE = 16 * 1024;
+
+		Archetype(const std::vector<const ComponentInfo*>& components);
+		~Archetype();
+
+		// Sorted by the id
+		std::vector<ComponentId> signature;
+		std::vector<const ComponentInfo*> components;
+
+		// Offsets of the columns in a chunk
+		std::vector<size_t> offsets;
+		size_t chunkCapacity;
+		size_t chunkBytes;
+
+		std::vector<std::unique_ptr<std::max_align_t[]>> chunks;
+		std::vector<Entity> entities;
+
+		// Archetypes that are reached by adding or removing a component
+		std::unordered_map<ComponentId, Archetype*> addEdges;
+		std::unordered_map<ComponentId, Archetype*> removeEdges;
+
+		size_t GetCount() const;
+
+		// Returns -1 if the archetype doesn't have the component
+		int GetColumn(ComponentId id) const;
+
+		void* GetComponent(size_t column, size_t row) const;
+
+		template <class T>
+		T* GetColumnData(size_t column, size_t chunk) const;
+
+		// The components of the new row aren't constructed
+		size_t AllocateRow(Entity entity);
+
+		// Returns the entity that was moved into the row or NULL_ENTITY
+		Entity RemoveRow(size_t row);
+	};
+
+	class World;
+
+	/*
+	* Iterates the entities that have all of the components, a const
+	* component type documents that the system only reads it
+	*/
+	template <class... T>
+	class View
+	{
+	public:
+		View(World& world);
+
+		// func(T&...) or func(Entity, T&...)
+		template <class F>
+		void ForEach(F&& func);
+
+		// func(size_t count, const Entity* entities, T*... columns) for every chunk,
+		// the columns are contiguous so the loops over them can be vectorized
+		template <class F>
+		void ForEachChunk(F&& func);
+
+		// Chunks are split between the threads of the pool
+		template <class F>
+		void ParallelForEach(ThreadPool& pool, F&& func);
+
+		size_t GetCount() const;
+
+	private:
+		template <class F, size_t... I>
+		void CallChunk(F& func, size_t archetype, size_t chunk, std::index_sequence<I...>);
+
+	private:
+		std::vector<Archetype*> m_Archetypes;
+		std::vector<std::array<int, sizeof...(T)>> m_Columns;
+
+	};
+
+	/*
+	* Entities and their components. Structural changes (Create, Destroy, Add and Remove)
+	* move components between archetypes so they must not happen while a view is being
+	* iterated or while the systems are running, use a CommandBuffer there instead
+	*/
+	class World
+	{
+	public:
+		World();
+		~World() = default;
+
+		World(const World&) = delete;
+		World& operator=(const World&) = delete;
+
+		template <class... T>
+		Entity Create(T&&... components);
+
+		void Destroy(Entity entity);
+		bool IsAlive(Entity entity) const;
+
+		// Replaces the component if the entity already has it
+		template <class T>
+		void Add(Entity entity, T&& component);
+
+		template <class T>
+		void Remove(Entity entity);
+
+		template <class T>
+		bool Has(Entity entity) const;
+
+		// Returns nullptr if the entity doesn't have the component
+		template <class T>
+		T* Get(Entity entity);
+
+		template <class... T>
+		View<T...> GetView();
+
+		size_t GetEntityCount() const;
+		size_t GetArchetypeCount() const;
+
+		const std::vector<Archetype*>& GetArchetypes() const;
+
+	private:
+		struct Record
+		{
+			Archetype* archetype;
+			size_t row;
+			uint32_t generation;
+		};
+
+		Entity AllocateEntity();
+
+		// Returns nullptr if a component is repeated
+		Archetype* GetArchetype(std::vector<const ComponentInfo*> components);
+		Archetype* GetAddTarget(Archetype* from, const ComponentInfo& info);
+		Archetype* GetRemoveTarget(Archetype* from, ComponentId id);
+
+		// Moves the shared components, the ones that are new to the entity aren't constructed
+		void MoveEntity(Entity entity, Archetype* to);
+
+		void SetRow(Entity entity, size_t row);
+
+	private:
+		std::vector<Record> m_Records;
+		std::vector<uint32_t> m_FreeIndices;
+
+		std::map<std::vector<ComponentId>, std::unique_ptr<Archetype>> m_ArchetypeMap;
+		std::vector<Archetype*> m_Archetypes;
+		Archetype* m_EmptyArchetype;
+
+		size_t m_EntityCount;
+
+	};
+
+	// Records structural changes that are applied to a world later in the same order
+	class CommandBuffer
+	{
+	public:
+		template <class... T>
+		void Create(T&&... components);
+
+		void Destroy(Entity entity);
+
+		template <class T>
+		void Add(Entity entity, T&& component);
+
+		template <class T>
+		void Remove(Entity entity);
+
+		void Apply(World& world);
+		bool IsEmpty() const;
+
+	private:
+		std::vector<std::function<void(World&)>> m_Commands;
+
+	};
+
+	// Components that a system reads and writes
+	struct SystemAccess
+	{
+		std::vector<ComponentId> reads;
+		std::vector<ComponentId> writes;
+
+		template <class... T>
+		SystemAccess& Read();
+
+		template <class... T>
+		SystemAccess& Write();
+
+		bool ConflictsWith(const SystemAccess& other) const;
+	};
+
+	/*
+	* A system waits only for the systems that were added before it and that write
+	* the components it accesses or read the components it writes, the rest run in
+	* parallel on the thread pool. Every system records its structural changes into
+	* its own command buffer, the buffers are applied in order after all of the systems
+	*/
+	class SystemScheduler
+	{
+	public:
+		using System = std::function<void(World&, CommandBuffer&)>;
+
+		size_t AddSystem(const SystemAccess& access, const System& system);
+		void Clear();
+
+		// The systems run on the calling thread if the pool is nullptr
+		void Run(World& world, ThreadPool* pool = nullptr);
+
+		const std::vector<size_t>& GetDependencies(size_t system) const;
+
+	private:
+		struct Entry
+		{
+			SystemAccess access;
+			System system;
+
+			CommandBuffer commands;
+			std::vector<size_t> dependencies;
+		};
+
+		std::vector<Entry> m_Systems;
+
+	};
+
+#ifdef DGE_ECS
+#undef DGE_ECS
+
+	template <class T>
+	const ComponentInfo& GetComponentInfo()
+	{
+		static_assert(alignof(T) <= alignof(std::max_align_t), "Over-aligned components aren't supported");
+
+		static const ComponentInfo info =
+		{
+			ComponentInfo::s_NextId++,
+			sizeof(T),
+			alignof(T),
+			[](void* dst, void* src) { new (dst) T(std::move(*(T*)src)); },
+			[](void* ptr) { ((T*)ptr)->~T(); }
+		};
+
+		return info;
+	}
+
+	template <class T>
+	ComponentId GetComponentId()
+	{
+		return GetComponentInfo<std::remove_cv_t<T>>().id;
+	}
+
+	Archetype::Archetype(const std::vector<const ComponentInfo*>& components) : components(components)
+	{
+		size_t rowSize = 0;
+
+		for (const ComponentInfo* info : components)
+		{
+			signature.push_back(info->id);
+			rowSize += info->size;
+		}
+
+		chunkCapacity = std::max<size_t>(1, CHUNK_SIZE / std::max<size_t>(1, rowSize));
+		chunkBytes = 0;
+
+		for (const ComponentInfo* info : components)
+		{
+			chunkBytes = (chunkBytes + info->alignment - 1) / info->alignment * info->alignment;
+			offsets.push_back(chunkBytes);
+			chunkBytes += info->size * chunkCapacity;
+		}
+	}
+
+	Archetype::~Archetype()
+	{
+		for (size_t row = 0; row < entities.size(); row++)
+		{
+			for (size_t column = 0; column < components.size(); column++)
+				components[column]->destroy(GetComponent(column, row));
+		}
+	}
+
+	size_t Archetype::GetCount() const
+	{
+		return entities.size();
+	}
+
+	int Archetype::GetColumn(ComponentId id) const
+	{
+		auto it = std::lower_bound(signature.begin(), signature.end(), id);
+
+		if (it == signature.end() || *it != id)
+			return -1;
+
+		return int(it - signature.begin());
+	}
+
+	void* Archetype::GetComponent(size_t column, size_t row) const
+	{
+		uint8_t* chunk = (uint8_t*)chunks[row / chunkCapacity].get();
+		return chunk + offsets[column] + (row % chunkCapacity) * components[column]->size;
+	}
+
+	template <class T>
+	T* Archetype::GetColumnData(size_t column, size_t chunk) const
+	{
+		return (T*)((uint8_t*)chunks[chunk].get() + offsets[column]);
+	}
+
+	size_t Archetype::AllocateRow(Entity entity)
+	{
+		size_t row = entities.size();
+
+		// Chunks are kept after the rows were removed so they can be reused
+		if (row / chunkCapacity >= chunks.size())
+		{
+			size_t elements = (chunkBytes + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t);
+			chunks.push_back(std::make_unique<std::max_align_t[]>(std::max<size_t>(1, elements)));
+		}
+
+		entities.push_back(entity);
+		return row;
+	}
+
+	Entity Archetype::RemoveRow(size_t row)
+	{
+		size_t last = entities.size() - 1;
+
+		for (size_t column = 0; column < components.size(); column++)
+		{
+			const ComponentInfo* info = components[column];
+			void* removed = GetComponent(column, row);
+
+			info->destroy(removed);
+
+			if (row != last)
+			{
+				void* moved = GetComponent(column, last);
+
+				info->moveConstruct(removed, moved);
+				info->destroy(moved);
+			}
+		}
+
+		Entity moved = NULL_ENTITY;
+
+		if (row != last)
+		{
+			moved = entities[last];
+			entities[row] = moved;
+		}
+
+		entities.pop_back();
+		return moved;
+	}
+
+	template <class... T>
+	View<T...>::View(World& world)
+	{
+		std::array<ComponentId, sizeof...(T)> ids = { GetComponentId<T>()... };
+
+		for (Archetype* archetype : world.GetArchetypes())
+		{
+			std::array<int, sizeof...(T)> columns;
+			bool matches = true;
+
+			for (size_t i = 0; i < ids.size() && matches; i++)
+			{
+				columns[i] = archetype->GetColumn(ids[i]);
+				matches = columns[i] >= 0;
+			}
+
+			if (matches)
+			{
+				m_Archetypes.push_back(archetype);
+				m_Columns.push_back(columns);
+			}
+		}
+	}
+
+	template <class... T>
+	template <class F, size_t... I>
+	void View<T...>::CallChunk(F& func, size_t archetype, size_t chunk, std::index_sequence<I...>)
+	{
+		Archetype* arch = m_Archetypes[archetype];
+
+		size_t first = chunk * arch->chunkCapacity;
+		size_t count = std::min(arch->chunkCapacity, arch->GetCount() - first);
+
+		func(count, arch->entities.data() + first, arch->template GetColumnData<std::remove_cv_t<T>>(m_Columns[archetype][I], chunk)...);
+	}
+
+	template <class... T>
+	template <class F>
+	void View<T...>::ForEachChunk(F&& func)
+	{
+		for (size_t i = 0; i < m_Archetypes.size(); i++)
+		{
+			size_t chunks = (m_Archetypes[i]->GetCount() + m_Archetypes[i]->chunkCapacity - 1) / m_Archetypes[i]->chunkCapacity;
+
+			for (size_t chunk = 0; chunk < chunks; chunk++)
+				CallChunk(func, i, chunk, std::index_sequence_for<T...>());
+		}
+	}
+
+	template <class... T>
+	template <class F>
+	void View<T...>::ForEach(F&& func)
+	{
+		ForEachChunk([&func](size_t count, const Entity* entities, T*... columns)
+			{
+				for (size_t i = 0; i < count; i++)
+				{
+					if constexpr (std::is_invocable_v<F&, Entity, T&...>)
+						func(entities[i], columns[i]...);
+					else
+						func(columns[i]...);
+				}
+			});
+	}
+
+	template <class... T>
+	template <class F>
+	void View<T...>::ParallelForEach(ThreadPool& pool, F&& func)
+	{
+		std::vector<std::pair<size_t, size_t>> chunks;
+
+		for (size_t i = 0; i < m_Archetypes.size(); i++)
+		{
+			size_t count = (m_Archetypes[i]->GetCount() + m_Archetypes[i]->chunkCapacity - 1) / m_Archetypes[i]->chunkCapacity;
+
+			for (size_t chunk = 0; chunk < count; chunk++)
+				chunks.push_back({ i, chunk });
+		}
+
+		auto ForChunk = [&func](size_t count, const Entity* entities, T*... columns)
+			{
+				for (size_t i = 0; i < count; i++)
+				{
+					if constexpr (std::is_invocable_v<F&, Entity, T&...>)
+						func(entities[i], columns[i]...);
+					else
+						func(columns[i]...);
+				}
+			};
+
+		pool.ParallelFor(0, int(chunks.size()), 1, [&](int i)
+			{
+				CallChunk(ForChunk, chunks[i].first, chunks[i].second, std::index_sequence_for<T...>());
+			});
+	}
+
+	template <class... T>
+	size_t View<T...>::GetCount() const
+	{
+		size_t count = 0;
+
+		for (Archetype* archetype : m_Archetypes)
+			count += archetype->GetCount();
+
+		return count;
+	}
+
+	World::World()
+	{
+		m_EntityCount = 0;
+		m_EmptyArchetype = GetArchetype({});
+	}
+
+	Entity World::AllocateEntity()
+	{
+		uint32_t index;
+
+		if (m_FreeIndices.empty())
+		{
+			index = uint32_t(m_Records.size());
+			m_Records.push_back({ nullptr, 0, 0 });
+		}
+		else
+		{
+			index = m_FreeIndices.back();
+			m_FreeIndices.pop_back();
+		}
+
+		m_EntityCount++;
+
+		return Entity(index) | (Entity(m_Records[index].generation) << 32);
+	}
+
+	template <class... T>
+	Entity World::Create(T&&... components)
+	{
+		static_assert(AreUnique<std::decay_t<T>...>::value, "An entity can't have the same component twice");
+
+		Archetype* archetype = GetArchetype({ &GetComponentInfo<std::decay_t<T>>()... });
+
+		if (!archetype)
+			return NULL_ENTITY;
+
+		Entity entity = AllocateEntity();
+		size_t row = archetype->AllocateRow(entity);
+
+		(new (archetype->GetComponent(archetype->GetColumn(GetComponentId<std::decay_t<T>>()), row)) std::decay_t<T>(std::forward<T>(components)), ...);
+
+		Record& record = m_Records[uint32_t(entity)];
+		record.archetype = archetype;
+		record.row = row;
+
+		return entity;
+	}
+
+	void World::Destroy(Entity entity)
+	{
+		if (!IsAlive(entity))
+			return;
+
+		Record& record = m_Records[uint32_t(entity)];
+		Entity moved = record.archetype->RemoveRow(record.row);
+
+		if (moved != NULL_ENTITY)
+			SetRow(moved, record.row);
+
+		// Handles to the old entity are invalidated by the new generation
+		record.archetype = nullptr;
+		record.generation++;
+
+		m_FreeIndices.push_back(uint32_t(entity));
+		m_EntityCount--;
+	}
+
+	bool World::IsAlive(Entity entity) const
+	{
+		uint32_t index = uint32_t(entity);
+		return index < m_Records.size() && m_Records[index].archetype && m_Records[index].generation == uint32_t(entity >> 32);
+	}
+
+	template <class T>
+	void World::Add(Entity entity, T&& component)
+	{
+		using Type = std::decay_t<T>;
+
+		if (!IsAlive(entity))
+			return;
+
+		if (Type* existing = Get<Type>(entity))
+		{
+			*existing = std::forward<T>(component);
+			return;
+		}
+
+		Record& record = m_Records[uint32_t(entity)];
+		Archetype* to = GetAddTarget(record.archetype, GetComponentInfo<Type>());
+
+		MoveEntity(entity, to);
+
+		new (to->GetComponent(to->GetColumn(GetComponentId<Type>()), record.row)) Type(std::forward<T>(component));
+	}
+
+	template <class T>
+	void World::Remove(Entity entity)
+	{
+		if (!Has<T>(entity))
+			return;
+
+		Record& record = m_Records[uint32_t(entity)];
+		MoveEntity(entity, GetRemoveTarget(record.archetype, GetComponentId<T>()));
+	}
+
+	template <class T>
+	bool World::Has(Entity entity) const
+	{
+		return IsAlive(entity) && m_Records[uint32_t(entity)].archetype->GetColumn(GetComponentId<T>()) >= 0;
+	}
+
+	template <class T>
+	T* World::Get(Entity entity)
+	{
+		if (!IsAlive(entity))
+			return nullptr;
+
+		const Record& record = m_Records[uint32_t(entity)];
+		int column = record.archetype->GetColumn(GetComponentId<T>());
+
+		if (column < 0)
+			return nullptr;
+
+		return (T*)record.archetype->GetComponent(column, record.row);
+	}
+
+	template <class... T>
+	View<T...> World::GetView()
+	{
+		return View<T...>(*this);
+	}
+
+	size_t World::GetEntityCount() const
+	{
+		return m_EntityCount;
+	}
+
+	size_t World::GetArchetypeCount() const
+	{
+		return m_Archetypes.size();
+	}
+
+	const std::vector<Archetype*>& World::GetArchetypes() const
+	{
+		return m_Archetypes;
+	}
+
+	Archetype* World::GetArchetype(std::vector<const ComponentInfo*> components)
+	{
+		std::sort(components.begin(), components.end(),
+			[](const ComponentInfo* lhs, const ComponentInfo* rhs) { return lhs->id < rhs->id; });
+
+		std::vector<ComponentId> signature;
+		signature.reserve(components.size());
+
+		for (const ComponentInfo* info : components)
+			signature.push_back(info->id);
+
+		if (std::adjacent_find(signature.begin(), signature.end()) != signature.end())
+			return nullptr;
+
+		auto it = m_ArchetypeMap.find(signature);
+
+		if (it != m_ArchetypeMap.end())
+			return it->second.get();
+
+		Archetype* archetype = new Archetype(components);
+
+		m_ArchetypeMap[signature].reset(archetype);
+		m_Archetypes.push_back(archetype);
+
+		return archetype;
+	}
+
+	Archetype* World::GetAddTarget(Archetype* from, const ComponentInfo& info)
+	{
+		Archetype*& to = from->addEdges[info.id];
+
+		if (!to)
+		{
+			std::vector<const ComponentInfo*> components = from->components;
+			components.push_back(&info);
+
+			to = GetArchetype(components);
+			to->removeEdges[info.id] = from;
+		}
+
+		return to;
+	}
+
+	Archetype* World::GetRemoveTarget(Archetype* from, ComponentId id)
+	{
+		Archetype*& to = from->removeEdges[id];
+
+		if (!to)
+		{
+			std::vector<const ComponentInfo*> components;
+
+			for (const ComponentInfo* info : from->components)
+			{
+				if (info->id != id)
+					components.push_back(info);
+			}
+
+			to = GetArchetype(components);
+			to->addEdges[id] = from;
+		}
+
+		return to;
+	}
+
+	void World::MoveEntity(Entity entity, Archetype* to)
+	{
+		Record& record = m_Records[uint32_t(entity)];
+		Archetype* from = record.archetype;
+
+		size_t row = to->AllocateRow(entity);
+
+		for (size_t column = 0; column < to->components.size(); column++)
+		{
+			int source = from->GetColumn(to->signature[column]);
+
+			if (source >= 0)
+				to->components[column]->moveConstruct(to->GetComponent(column, row), from->GetComponent(source, record.row));
+		}
+
+		// The moved-from components and the ones that aren't in the new archetype are destroyed here
+		Entity moved = from->RemoveRow(record.row);
+
+		if (moved != NULL_ENTITY)
+			SetRow(moved, record.row);
+
+		record.archetype = to;
+		record.row = row;
+	}
+
+	void World::SetRow(Entity entity, size_t row)
+	{
+		m_Records[uint32_t(entity)].row = row;
+	}
+
+	template <class... T>
+	void CommandBuffer::Create(T&&... components)
+	{
+		m_Commands.push_back([values = std::make_tuple(std::decay_t<T>(std::forward<T>(components))...)](World& world) mutable
+			{
+				std::apply([&world](auto&... args) { world.Create(std::move(args)...); }, values);
+			});
+	}
+
+	void CommandBuffer::Destroy(Entity entity)
+	{
+		m_Commands.push_back([entity](World& world) { world.Destroy(entity); });
+	}
+
+	template <class T>
+	void CommandBuffer::Add(Entity entity, T&& component)
+	{
+		m_Commands.push_back([entity, value = std::decay_t<T>(std::forward<T>(component))](World& world) mutable
+			{
+				world.Add(entity, std::move(value));
+			});
+	}
+
+	template <class T>
+	void CommandBuffer::Remove(Entity entity)
+	{
+		m_Commands.push_back([entity](World& world) { world.Remove<T>(entity); });
+	}
+
+	void CommandBuffer::Apply(World& world)
+	{
+		for (auto& command : m_Commands)
+			command(world);
+
+		m_Commands.clear();
+	}
+
+	bool CommandBuffer::IsEmpty() const
+	{
+		return m_Commands.empty();
+	}
+
+	template <class... T>
+	SystemAccess& SystemAccess::Read()
+	{
+		(reads.push_back(GetComponentId<T>()), ...);
+		return *this;
+	}
+
+	template <class... T>
+	SystemAccess& SystemAccess::Write()
+	{
+		(writes.push_back(GetComponentId<T>()), ...);
+		return *this;
+	}
+
+	bool SystemAccess::ConflictsWith(const SystemAccess& other) const
+	{
+		auto Intersects = [](const std::vector<ComponentId>& lhs, const std::vector<ComponentId>& rhs)
+			{
+				for (ComponentId id : lhs)
+				{
+					if (std::find(rhs.begin(), rhs.end(), id) != rhs.end())
+						return true;
+				}
+
+				return false;
+			};
+
+		return Intersects(writes, other.writes) || Intersects(writes, other.reads) || Intersects(reads, other.writes);
+	}
+
+	size_t SystemScheduler::AddSystem(const SystemAccess& access, const System& system)
+	{
+		Entry& entry = m_Systems.emplace_back();
+
+		entry.access = access;
+		entry.system = system;
+
+		for (size_t i = 0; i + 1 < m_Systems.size(); i++)
+		{
+			if (m_Systems[i].access.ConflictsWith(access))
+				entry.dependencies.push_back(i);
+		}
+
+		return m_Systems.size() - 1;
+	}
+
+	void SystemScheduler::Clear()
+	{
+		m_Systems.clear();
+	}
+
+	void SystemScheduler::Run(World& world, ThreadPool* pool)
+	{
+		if (pool)
+		{
+			std::vector<ThreadPool::TaskHandle> tasks;
+			tasks.reserve(m_Systems.size());
+
+			for (Entry& entry : m_Systems)
+			{
+				std::vector<ThreadPool::TaskHandle> dependencies;
+
+				for (size_t i : entry.dependencies)
+					dependencies.push_back(tasks[i]);
+
+				tasks.push_back(pool->Schedule([&world, &entry]() { entry.system(world, entry.commands); }, dependencies));
+			}
+
+			for (const auto& task : tasks)
+				pool->Wait(task);
+		}
+		else
+		{
+			for (Entry& entry : m_Systems)
+				entry.system(world, entry.commands);
+		}
+
+		for (Entry& entry : m_Systems)
+			entry.commands.Apply(world);
+	}
+
+	const std::vector<size_t>& SystemScheduler::GetDependencies(size_t system) const
+	{
+		return m_Systems[system].dependencies;
+	}
+
+#endif
+
+}
+
+#endif
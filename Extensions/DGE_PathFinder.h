@@ -31,9 +31,12 @@
 
 #pragma region Includes
 
-#include <list>
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 #include "defGameEngine.hpp"
@@ -58,46 +61,2314 @@ namespace def
 		Node* parent;
 	};
 
+	// The cost of the shortest path on an empty grid with 8 neighbours
+	float OctileDistance(const def::vi2d& lhs, const def::vi2d& rhs);
+
+	/*
+	* Binary min-heap of indices in [0, capacity) that keeps
+	* the position of every index so its key can be decreased,
+	* compare(lhs, rhs) must return true if the key of lhs is smaller
+	*/
+	template <class Compare>
+	class IndexedHeap
+	{
+	public:
+		IndexedHeap(const Compare& compare = Compare());
+
+		void Reserve(size_t capacity);
+		void Clear();
+
+		bool IsEmpty() const;
+		bool Contains(size_t index) const;
+
+		void Push(size_t index);
+		size_t Pop();
+
+		size_t Top() const;
+		void Remove(size_t index);
+
+		// Must be called after the key of the index has decreased
+		void Update(size_t index);
+
+		// Must be called after the key of the index has changed in any direction
+		void Reposition(size_t index);
+
+		// Used by the owners that move the data the comparator points to
+		void SetCompare(const Compare& compare);
+
+	private:
+		void SiftUp(size_t pos);
+		void SiftDown(size_t pos);
+
+		void Place(size_t pos, size_t index);
+
+	private:
+		static constexpr size_t NPOS = (size_t)-1;
+
+		std::vector<size_t> m_Heap;
+		std::vector<size_t> m_Positions;
+
+		Compare m_Compare;
+
+	};
+
 	class PathFinder
 	{
-	public:
-		PathFinder();
-		~PathFinder();
+	public:
+		PathFinder();
+		~PathFinder();
+
+	private:
+		struct NodeCompare
+		{
+			const Node* nodes = nullptr;
+
+			bool operator()(size_t lhs, size_t rhs) const;
+		};
+
+	private:
+		def::vi2d m_MapSize;
+
+		Node* m_Nodes;
+
+		IndexedHeap<NodeCompare> m_OpenSet;
+
+		Node* m_Start;
+		Node* m_Goal;
+
+		bool m_IsMapFreed;
+
+		// 8 jump distances per node for JPS+, positive values are the distances
+		// to the next jump point, the others are the negated distances to a wall
+		std::vector<int> m_JumpDistances;
+
+	public:
+		void ClearMap();
+		bool FreeMap();
+		bool ConstructMap(const def::vi2d& size);
+
+		bool SetNodes(const def::vi2d& start, const def::vi2d& goal);
+		void SetNodes(Node* start = nullptr, Node* goal = nullptr);
+
+		Node* GetStartNode();
+		Node* GetGoalNode();
+		Node* GetNodes();
+
+		void ResetNodes();
+
+		int GetMapWidth() const;
+		int GetMapHeight() const;
+		def::vi2d GetMapSize() const;
+
+		void FindPath(float (*dist)(Node*, Node*), float (*heuristic)(Node*, Node*));
+
+		// Jump Point Search on the map built by ConstructMap with the uniform costs
+		// (1 for straight and sqrt(2) for diagonal moves), only the jump points are expanded
+		// but the parent chain of the found path goes through every node of it
+		void FindPathJPS(float (*heuristic)(Node*, Node*));
+
+		// Same as FindPathJPS but the jumps are read from the distances computed
+		// by PrecomputeJumpPoints that must be called again after the obstacles change,
+		// they are computed by the first search after ConstructMap if it wasn't called
+		void PrecomputeJumpPoints();
+		void FindPathJPSPlus(float (*heuristic)(Node*, Node*));
+
+	private:
+		bool IsWalkable(int x, int y) const;
+		Node* GetNode(int x, int y);
+
+		// Fills the directions to search from the node given the direction it was reached from
+		int GetJumpDirections(Node* node, def::vi2d* directions) const;
+		Node* Jump(int x, int y, int dx, int dy);
+
+		bool IsForced(int x, int y, int dx, int dy) const;
+		int& JumpDistance(int x, int y, int dx, int dy);
+
+		template <class Successors>
+		void SearchJumpPoints(float (*heuristic)(Node*, Node*), Successors&& successors);
+
+	};
+
+	/*
+	* Grid mode of the PathFinder: the neighbours (the same 8 as in ConstructMap)
+	* are computed from the index, the search data is stored in flat arrays
+	* and is invalidated in O(1) by bumping the generation counter.
+	* The map is only read by a search, all of the data that a search writes
+	* lives in a Scratch so searches with different scratches can run at the same time
+	*/
+	class GridPathFinder
+	{
+	public:
+		static constexpr uint32_t NO_PARENT = (uint32_t)-1;
+
+		GridPathFinder();
+
+		GridPathFinder(const GridPathFinder&) = delete;
+		GridPathFinder& operator=(const GridPathFinder&) = delete;
+
+	private:
+		struct ScratchCompare
+		{
+			const float* globalGoals = nullptr;
+			const float* localGoals = nullptr;
+
+			bool operator()(size_t lhs, size_t rhs) const;
+		};
+
+	public:
+		class Scratch
+		{
+		public:
+			Scratch();
+
+			Scratch(const Scratch&) = delete;
+			Scratch& operator=(const Scratch&) = delete;
+
+			// The comparator of the open set is pointed to the moved data
+			Scratch(Scratch&& other) noexcept;
+			Scratch& operator=(Scratch&& other) noexcept;
+
+			// Reallocates the data only if the number of nodes has changed
+			void Resize(size_t count);
+
+			// Invalidates the data of the previous search
+			void Clear();
+
+			bool IsVisited(uint32_t index) const;
+			float GetLocalGoal(uint32_t index) const;
+			uint32_t GetParent(uint32_t index) const;
+
+		private:
+			// Makes the data of the node valid for the current generation
+			void Touch(uint32_t index);
+
+		private:
+			// The lowest bit is set if the node is visited, the rest is the generation
+			// at which the data of the node was written
+			std::vector<uint32_t> m_Stamps;
+
+			std::vector<float> m_GlobalGoals;
+			std::vector<float> m_LocalGoals;
+			std::vector<uint32_t> m_Parents;
+
+			IndexedHeap<ScratchCompare> m_OpenSet;
+
+			uint32_t m_Generation;
+
+			friend class GridPathFinder;
+
+		};
+
+		struct PathRequest
+		{
+			def::vi2d start;
+			def::vi2d goal;
+		};
+
+	private:
+		def::vi2d m_MapSize;
+
+		std::vector<uint64_t> m_Obstacles;
+
+		// Used by the searches that go through SetNodes
+		Scratch m_Scratch;
+
+		// The scratches that aren't used by any of the FindPaths chunks at the moment,
+		// a new one is created when all of them are taken
+		std::vector<std::unique_ptr<Scratch>> m_FreeScratches;
+		std::mutex m_ScratchMutex;
+
+		uint32_t m_Start;
+		uint32_t m_Goal;
+
+	public:
+		bool ConstructMap(const def::vi2d& size);
+		void ClearMap();
+
+		void SetObstacle(const def::vi2d& pos, bool isObstacle);
+		bool IsObstacle(const def::vi2d& pos) const;
+
+		bool SetNodes(const def::vi2d& start, const def::vi2d& goal);
+
+		// Returns true if the goal was reached
+		bool FindPath(float (*dist)(const def::vi2d&, const def::vi2d&), float (*heuristic)(const def::vi2d&, const def::vi2d&));
+
+		// Can be called from many threads at once as long as each one passes its own scratch,
+		// the path is a list of the node indices from the start to the goal and is empty if the goal wasn't reached
+		bool FindPath(const def::vi2d& start, const def::vi2d& goal, std::vector<uint32_t>& path, Scratch& scratch,
+			float (*dist)(const def::vi2d&, const def::vi2d&), float (*heuristic)(const def::vi2d&, const def::vi2d&)) const;
+
+		// Runs all of the requests on the thread pool, the paths are stored in the same order as the requests,
+		// it can be called from many threads at once but not while the map is being changed
+		void FindPaths(ThreadPool& pool, const std::vector<PathRequest>& requests, std::vector<std::vector<uint32_t>>& paths,
+			float (*dist)(const def::vi2d&, const def::vi2d&), float (*heuristic)(const def::vi2d&, const def::vi2d&));
+
+		bool IsVisited(const def::vi2d& pos) const;
+		float GetLocalGoal(const def::vi2d& pos) const;
+		uint32_t GetParent(uint32_t index) const;
+
+		// From the start to the goal, empty if the goal wasn't reached
+		std::vector<def::vi2d> GetPath() const;
+
+		uint32_t ToIndex(const def::vi2d& pos) const;
+		def::vi2d ToPos(uint32_t index) const;
+
+		int GetMapWidth() const;
+		int GetMapHeight() const;
+		def::vi2d GetMapSize() const;
+
+	private:
+		bool IsInside(const def::vi2d& pos) const;
+		bool IsObstacle(uint32_t index) const;
+
+		bool Search(uint32_t start, uint32_t goal, Scratch& scratch,
+			float (*dist)(const def::vi2d&, const def::vi2d&), float (*heuristic)(const def::vi2d&, const def::vi2d&)) const;
+
+	};
+
+	/*
+	* HPA*: the map is split into clusters, the entrances between
+	* them and the costs between the entrances of every cluster
+	* form an abstract graph that is searched first, the path is
+	* refined inside of the clusters only when it's needed
+	*/
+	class HierarchicalPathFinder
+	{
+	public:
+		HierarchicalPathFinder();
+
+		HierarchicalPathFinder(const HierarchicalPathFinder&) = delete;
+		HierarchicalPathFinder& operator=(const HierarchicalPathFinder&) = delete;
+
+	private:
+		struct Edge
+		{
+			int to;
+			float cost;
+		};
+
+		struct AbstractNode
+		{
+			def::vi2d pos;
+			int cluster;
+			bool isAlive;
+
+			std::vector<Edge> edges;
+		};
+
+		struct Cluster
+		{
+			def::vi2d pos;
+			def::vi2d size;
+
+			std::vector<int> nodes;
+			bool isDirty;
+		};
+
+		struct CostCompare
+		{
+			const float* costs = nullptr;
+
+			bool operator()(size_t lhs, size_t rhs) const;
+		};
+
+	private:
+		def::vi2d m_MapSize;
+		def::vi2d m_Clusters;
+		int m_ClusterSize;
+
+		std::vector<uint64_t> m_Obstacles;
+
+		std::vector<Cluster> m_ClusterData;
+		std::vector<AbstractNode> m_Nodes;
+		std::vector<int> m_FreeNodes;
+
+		// Entrance nodes owned by the border on the right and the bottom of every cluster
+		std::vector<std::vector<int>> m_RightBorders;
+		std::vector<std::vector<int>> m_BottomBorders;
+
+		// Scratch data of a search inside of a cluster
+		std::vector<float> m_LocalCosts;
+		std::vector<int> m_LocalParents;
+		IndexedHeap<CostCompare> m_LocalOpenSet;
+
+		// Scratch data of the abstract search
+		std::vector<float> m_LocalGoals;
+		std::vector<float> m_GlobalGoals;
+		std::vector<int> m_Parents;
+		std::vector<float> m_GoalCosts;
+		IndexedHeap<CostCompare> m_OpenSet;
+
+		std::vector<def::vi2d> m_AbstractPath;
+		size_t m_RefinedSegments;
+
+	public:
+		bool ConstructMap(const def::vi2d& size, int clusterSize = 32);
+
+		// Marks the cluster of the node to be rebuilt on the next search
+		void SetObstacle(const def::vi2d& pos, bool isObstacle);
+		bool IsObstacle(const def::vi2d& pos) const;
+
+		// Rebuilds the entrances and the costs of the changed clusters only
+		void Rebuild();
+
+		// Searches the abstract graph, returns false if the goal can't be reached
+		bool FindPath(const def::vi2d& start, const def::vi2d& goal);
+
+		// The start, the entrances the path goes through and the goal
+		const std::vector<def::vi2d>& GetAbstractPath() const;
+
+		// Appends the nodes of the next abstract segment to the path,
+		// returns false if the whole path was refined
+		bool RefineNext(std::vector<def::vi2d>& path);
+
+		// Refines the rest of the path
+		std::vector<def::vi2d> GetPath();
+
+		size_t GetAbstractNodeCount() const;
+
+		int GetMapWidth() const;
+		int GetMapHeight() const;
+		def::vi2d GetMapSize() const;
+
+	private:
+		bool IsWalkable(int x, int y) const;
+		int GetClusterIndex(const def::vi2d& pos) const;
+
+		int CreateNode(const def::vi2d& pos);
+		void RemoveBorder(std::vector<int>& border);
+		void BuildBorder(std::vector<int>& border, const def::vi2d& start, const def::vi2d& step, const def::vi2d& across, int length);
+		void BuildEdges(int cluster);
+
+		// Dijkstra inside of the cluster that stops at the target if it's not -1,
+		// the costs and the parents are indexed by the position inside of the cluster
+		void SearchCluster(int cluster, const def::vi2d& source, int target);
+		int GetLocalIndex(int cluster, const def::vi2d& pos) const;
+
+	};
+
+	/*
+	* Dijkstra integration field from one or more goals and the direction field
+	* that points every cell to its cheapest neighbour, so any number of units
+	* heading to the same goals can read their next step in O(1)
+	*/
+	class FlowField
+	{
+	public:
+		static constexpr uint8_t NO_DIRECTION = 8;
+
+		FlowField();
+
+		FlowField(const FlowField&) = delete;
+		FlowField& operator=(const FlowField&) = delete;
+
+	private:
+		struct CostCompare
+		{
+			const float* costs = nullptr;
+
+			bool operator()(size_t lhs, size_t rhs) const;
+		};
+
+	private:
+		def::vi2d m_MapSize;
+
+		std::vector<uint64_t> m_Obstacles;
+
+		std::vector<float> m_Costs;
+
+		// Index of the offset to the next cell, NO_DIRECTION for the goals and the unreachable cells
+		std::vector<uint8_t> m_Directions;
+
+		std::vector<uint32_t> m_Goals;
+		std::vector<uint8_t> m_IsGoal;
+
+		// The cells whose obstacle flag has changed since the last flood
+		std::vector<uint32_t> m_Changed;
+
+		IndexedHeap<CostCompare> m_OpenSet;
+
+		bool m_IsBuilt;
+
+	public:
+		bool ConstructMap(const def::vi2d& size);
+
+		void SetObstacle(const def::vi2d& pos, bool isObstacle);
+		bool IsObstacle(const def::vi2d& pos) const;
+
+		// Copies the isObstacle flags of the nodes, the maps must be of the same size
+		void SetObstacles(PathFinder& pathFinder);
+
+		// The goals are only applied by the next Build
+		void AddGoal(const def::vi2d& pos);
+		void ClearGoals();
+
+		// Floods the whole map from the goals
+		void Build();
+
+		// Floods only the cells affected by the obstacles that have changed since the last flood
+		void Update();
+
+		// INFINITY if the cell can't reach any of the goals
+		float GetCost(const def::vi2d& pos) const;
+
+		// The step to the next cell, (0, 0) at the goals and the cells that can't reach them
+		def::vi2d GetDirection(const def::vi2d& pos) const;
+
+		int GetMapWidth() const;
+		int GetMapHeight() const;
+		def::vi2d GetMapSize() const;
+
+	private:
+		bool IsInside(const def::vi2d& pos) const;
+		bool IsObstacle(uint32_t index) const;
+
+		// Relaxes the neighbours of the cells in the open set until it's empty
+		void Flood();
+
+	};
+
+	/*
+	* D* Lite: the search runs from the goal to the start and keeps its state
+	* between the calls, so after the obstacles change or the start moves
+	* only the part of the search tree that is affected is repaired.
+	* Uses the same 8 neighbours as the GridPathFinder and the octile distance
+	* as the heuristic, the costs are stored in fixed point (1 and 1.414)
+	* so the keys of the nodes on equally long paths are exactly equal
+	*/
+	class IncrementalPathFinder
+	{
+	public:
+		static constexpr uint32_t NO_NODE = (uint32_t)-1;
+
+		IncrementalPathFinder();
+
+		IncrementalPathFinder(const IncrementalPathFinder&) = delete;
+		IncrementalPathFinder& operator=(const IncrementalPathFinder&) = delete;
+
+	private:
+		static constexpr int32_t STRAIGHT_COST = 1000;
+		static constexpr int32_t DIAGONAL_COST = 1414;
+		static constexpr int32_t INFINITE_COST = INT32_MAX;
+
+		struct KeyCompare
+		{
+			const int64_t* primaryKeys = nullptr;
+			const int32_t* secondaryKeys = nullptr;
+
+			bool operator()(size_t lhs, size_t rhs) const;
+		};
+
+	private:
+		def::vi2d m_MapSize;
+
+		std::vector<uint64_t> m_Obstacles;
+
+		std::vector<int32_t> m_Goals;
+		std::vector<int32_t> m_Lookaheads;
+
+		std::vector<int64_t> m_PrimaryKeys;
+		std::vector<int32_t> m_SecondaryKeys;
+
+		IndexedHeap<KeyCompare> m_OpenSet;
+
+		uint32_t m_Start;
+		uint32_t m_Goal;
+
+		// The start at the time the keys were last corrected by m_KeyModifier
+		uint32_t m_LastStart;
+		int64_t m_KeyModifier;
+
+		size_t m_ExpandedCount;
+
+	public:
+		bool ConstructMap(const def::vi2d& size);
+
+		// Repairs the search on the next FindPath
+		void SetObstacle(const def::vi2d& pos, bool isObstacle);
+		bool IsObstacle(const def::vi2d& pos) const;
+
+		// Changing the goal starts a new search
+		bool SetGoal(const def::vi2d& pos);
+
+		// The start can move between the searches without losing the search state
+		bool SetStart(const def::vi2d& pos);
+
+		// Returns true if the goal can be reached from the start
+		bool FindPath();
+
+		// From the start to the goal, empty if the goal can't be reached
+		std::vector<def::vi2d> GetPath() const;
+
+		// The cost from the cell to the goal found by the last search
+		float GetCost(const def::vi2d& pos) const;
+
+		// The number of the nodes that the last FindPath has expanded
+		size_t GetExpandedCount() const;
+
+		int GetMapWidth() const;
+		int GetMapHeight() const;
+		def::vi2d GetMapSize() const;
+
+	private:
+		bool IsInside(const def::vi2d& pos) const;
+		bool IsObstacle(uint32_t index) const;
+
+		def::vi2d ToPos(uint32_t index) const;
+
+		int32_t Heuristic(uint32_t lhs, uint32_t rhs) const;
+
+		// INFINITE_COST if any of the nodes is an obstacle
+		int32_t Cost(uint32_t from, uint32_t to) const;
+		int32_t AddCosts(int32_t lhs, int32_t rhs) const;
+
+		// Returns the number of the neighbours inside of the map
+		int GetNeighbours(uint32_t index, uint32_t* neighbours) const;
+
+		void CalculateKey(uint32_t index, int64_t& primary, int32_t& secondary) const;
+
+		// Recomputes the lookahead from the neighbours
+		void UpdateLookahead(uint32_t index);
+		void UpdateNode(uint32_t index);
+
+	};
+
+#ifdef DGE_PATHFINDER
+#undef DGE_PATHFINDER
+
+	// The 8 neighbours of a cell, the straight ones go first
+	static const def::vi2d NEIGHBOUR_OFFSETS[8] =
+	{
+		{ 0, -1 }, { 0, 1 }, { -1, 0 }, { 1, 0 },
+		{ -1, -1 }, { 1, 1 }, { -1, 1 }, { 1, -1 }
+	};
+
+	static const float NEIGHBOUR_COSTS[8] =
+	{
+		1.0f, 1.0f, 1.0f, 1.0f,
+		1.41421356f, 1.41421356f, 1.41421356f, 1.41421356f
+	};
+
+	float OctileDistance(const def::vi2d& lhs, const def::vi2d& rhs)
+	{
+		int dx = abs(lhs.x - rhs.x);
+		int dy = abs(lhs.y - rhs.y);
+
+		return float(std::max(dx, dy) - std::min(dx, dy)) + 1.41421356f * float(std::min(dx, dy));
+	}
+
+	template <class Compare>
+	IndexedHeap<Compare>::IndexedHeap(const Compare& compare) : m_Compare(compare)
+	{
+	}
+
+	template <class Compare>
+	void IndexedHeap<Compare>::Reserve(size_t capacity)
+	{
+		m_Heap.reserve(capacity);
+		m_Positions.resize(capacity, NPOS);
+	}
+
+	template <class Compare>
+	void IndexedHeap<Compare>::Clear()
+	{
+		for (size_t index : m_Heap)
+			m_Positions[index] = NPOS;
+
+		m_Heap.clear();
+	}
+
+	template <class Compare>
+	bool IndexedHeap<Compare>::IsEmpty() const
+	{
+		return m_Heap.empty();
+	}
+
+	template <class Compare>
+	bool IndexedHeap<Compare>::Contains(size_t index) const
+	{
+		return index < m_Positions.size() && m_Positions[index] != NPOS;
+	}
+
+	template <class Compare>
+	void IndexedHeap<Compare>::Push(size_t index)
+	{
+		if (index >= m_Positions.size())
+			m_Positions.resize(index + 1, NPOS);
+
+		m_Heap.push_back(index);
+		m_Positions[index] = m_Heap.size() - 1;
+
+		SiftUp(m_Heap.size() - 1);
+	}
+
+	template <class Compare>
+	size_t IndexedHeap<Compare>::Pop()
+	{
+		size_t top = m_Heap.front();
+		m_Positions[top] = NPOS;
+
+		size_t last = m_Heap.back();
+		m_Heap.pop_back();
+
+		if (!m_Heap.empty())
+		{
+			Place(0, last);
+			SiftDown(0);
+		}
+
+		return top;
+	}
+
+	template <class Compare>
+	size_t IndexedHeap<Compare>::Top() const
+	{
+		return m_Heap.front();
+	}
+
+	template <class Compare>
+	void IndexedHeap<Compare>::Remove(size_t index)
+	{
+		size_t pos = m_Positions[index];
+		m_Positions[index] = NPOS;
+
+		size_t last = m_Heap.back();
+		m_Heap.pop_back();
+
+		if (pos < m_Heap.size())
+		{
+			Place(pos, last);
+			Reposition(last);
+		}
+	}
+
+	template <class Compare>
+	void IndexedHeap<Compare>::Update(size_t index)
+	{
+		SiftUp(m_Positions[index]);
+	}
+
+	template <class Compare>
+	void IndexedHeap<Compare>::Reposition(size_t index)
+	{
+		SiftUp(m_Positions[index]);
+		SiftDown(m_Positions[index]);
+	}
+
+	template <class Compare>
+	void IndexedHeap<Compare>::SetCompare(const Compare& compare)
+	{
+		m_Compare = compare;
+	}
+
+	template <class Compare>
+	void IndexedHeap<Compare>::SiftUp(size_t pos)
+	{
+		size_t index = m_Heap[pos];
+
+		while (pos > 0)
+		{
+			size_t parent = (pos - 1) / 2;
+
+			if (!m_Compare(index, m_Heap[parent]))
+				break;
+
+			Place(pos, m_Heap[parent]);
+			pos = parent;
+		}
+
+		Place(pos, index);
+	}
+
+	template <class Compare>
+	void IndexedHeap<Compare>::SiftDown(size_t pos)
+	{
+		size_t index = m_Heap[pos];
+		size_t count = m_Heap.size();
+
+		while (true)
+		{
+			size_t child = pos * 2 + 1;
+
+			if (child >= count)
+				break;
+
+			if (child + 1 < count && m_Compare(m_Heap[child + 1], m_Heap[child]))
+				child++;
+
+			if (!m_Compare(m_Heap[child], index))
+				break;
+
+			Place(pos, m_Heap[child]);
+			pos = child;
+		}
+
+		Place(pos, index);
+	}
+
+	template <class Compare>
+	void IndexedHeap<Compare>::Place(size_t pos, size_t index)
+	{
+		m_Heap[pos] = index;
+		m_Positions[index] = pos;
+	}
+
+	bool PathFinder::NodeCompare::operator()(size_t lhs, size_t rhs) const
+	{
+		// Prefers the deeper node on ties so fewer nodes are expanded
+		if (nodes[lhs].globalGoal == nodes[rhs].globalGoal)
+			return nodes[lhs].localGoal > nodes[rhs].localGoal;
+
+		return nodes[lhs].globalGoal < nodes[rhs].globalGoal;
+	}
+
+	bool GridPathFinder::ScratchCompare::operator()(size_t lhs, size_t rhs) const
+	{
+		if (globalGoals[lhs] == globalGoals[rhs])
+			return localGoals[lhs] > localGoals[rhs];
+
+		return globalGoals[lhs] < globalGoals[rhs];
+	}
+
+	GridPathFinder::Scratch::Scratch()
+	{
+		m_Generation = 0;
+	}
+
+	GridPathFinder::Scratch::Scratch(Scratch&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	GridPathFinder::Scratch& GridPathFinder::Scratch::operator=(Scratch&& other) noexcept
+	{
+		m_Stamps = std::move(other.m_Stamps);
+		m_GlobalGoals = std::move(other.m_GlobalGoals);
+		m_LocalGoals = std::move(other.m_LocalGoals);
+		m_Parents = std::move(other.m_Parents);
+
+		m_OpenSet = std::move(other.m_OpenSet);
+		m_OpenSet.SetCompare({ m_GlobalGoals.data(), m_LocalGoals.data() });
+
+		m_Generation = other.m_Generation;
+		other.m_Generation = 0;
+
+		return *this;
+	}
+
+	void GridPathFinder::Scratch::Resize(size_t count)
+	{
+		if (m_Stamps.size() == count)
+			return;
+
+		m_Stamps.assign(count, 0);
+		m_GlobalGoals.assign(count, INFINITY);
+		m_LocalGoals.assign(count, INFINITY);
+		m_Parents.assign(count, NO_PARENT);
+
+		m_OpenSet = IndexedHeap<ScratchCompare>({ m_GlobalGoals.data(), m_LocalGoals.data() });
+		m_OpenSet.Reserve(count);
+
+		m_Generation = 1;
+	}
+
+	void GridPathFinder::Scratch::Clear()
+	{
+		m_Generation++;
+
+		// The stamps keep the generation above the visited bit so it wraps at 2^31
+		if (m_Generation == (1u << 31))
+		{
+			std::fill(m_Stamps.begin(), m_Stamps.end(), 0);
+			m_Generation = 1;
+		}
+	}
+
+	bool GridPathFinder::Scratch::IsVisited(uint32_t index) const
+	{
+		uint32_t stamp = m_Stamps[index];
+		return (stamp >> 1) == m_Generation && (stamp & 1);
+	}
+
+	float GridPathFinder::Scratch::GetLocalGoal(uint32_t index) const
+	{
+		return (m_Stamps[index] >> 1) == m_Generation ? m_LocalGoals[index] : INFINITY;
+	}
+
+	uint32_t GridPathFinder::Scratch::GetParent(uint32_t index) const
+	{
+		return (m_Stamps[index] >> 1) == m_Generation ? m_Parents[index] : NO_PARENT;
+	}
+
+	void GridPathFinder::Scratch::Touch(uint32_t index)
+	{
+		if ((m_Stamps[index] >> 1) == m_Generation)
+			return;
+
+		m_Stamps[index] = m_Generation << 1;
+
+		m_GlobalGoals[index] = INFINITY;
+		m_LocalGoals[index] = INFINITY;
+		m_Parents[index] = NO_PARENT;
+	}
+
+	GridPathFinder::GridPathFinder()
+	{
+		m_Start = NO_PARENT;
+		m_Goal = NO_PARENT;
+	}
+
+	bool GridPathFinder::ConstructMap(const def::vi2d& size)
+	{
+		if (size.x <= 0 || size.y <= 0)
+			return false;
+
+		m_MapSize = size;
+
+		size_t count = size.x * size.y;
+
+		m_Obstacles.assign((count + 63) / 64, 0);
+		m_Scratch.Resize(count);
+
+		m_Start = NO_PARENT;
+		m_Goal = NO_PARENT;
+
+		return true;
+	}
+
+	void GridPathFinder::ClearMap()
+	{
+		m_Scratch.Clear();
+	}
+
+	void GridPathFinder::SetObstacle(const def::vi2d& pos, bool isObstacle)
+	{
+		if (!IsInside(pos))
+			return;
+
+		uint32_t index = ToIndex(pos);
+		uint64_t bit = 1ull << (index % 64);
+
+		if (isObstacle)
+			m_Obstacles[index / 64] |= bit;
+		else
+			m_Obstacles[index / 64] &= ~bit;
+	}
+
+	bool GridPathFinder::IsObstacle(const def::vi2d& pos) const
+	{
+		return IsInside(pos) && IsObstacle(ToIndex(pos));
+	}
+
+	bool GridPathFinder::SetNodes(const def::vi2d& start, const def::vi2d& goal)
+	{
+		if (!IsInside(start) || !IsInside(goal))
+			return false;
+
+		m_Start = ToIndex(start);
+		m_Goal = ToIndex(goal);
+
+		return true;
+	}
+
+	bool GridPathFinder::FindPath(float (*dist)(const def::vi2d&, const def::vi2d&), float (*heuristic)(const def::vi2d&, const def::vi2d&))
+	{
+		if (m_Start == NO_PARENT || m_Goal == NO_PARENT)
+			return false;
+
+		return Search(m_Start, m_Goal, m_Scratch, dist, heuristic);
+	}
+
+	bool GridPathFinder::FindPath(const def::vi2d& start, const def::vi2d& goal, std::vector<uint32_t>& path, Scratch& scratch,
+		float (*dist)(const def::vi2d&, const def::vi2d&), float (*heuristic)(const def::vi2d&, const def::vi2d&)) const
+	{
+		path.clear();
+
+		if (!IsInside(start) || !IsInside(goal))
+			return false;
+
+		scratch.Resize(m_MapSize.x * m_MapSize.y);
+
+		uint32_t goalIndex = ToIndex(goal);
+
+		if (!Search(ToIndex(start), goalIndex, scratch, dist, heuristic))
+			return false;
+
+		for (uint32_t index = goalIndex; index != NO_PARENT; index = scratch.GetParent(index))
+			path.push_back(index);
+
+		std::reverse(path.begin(), path.end());
+		return true;
+	}
+
+	void GridPathFinder::FindPaths(ThreadPool& pool, const std::vector<PathRequest>& requests, std::vector<std::vector<uint32_t>>& paths,
+		float (*dist)(const def::vi2d&, const def::vi2d&), float (*heuristic)(const def::vi2d&, const def::vi2d&))
+	{
+		paths.resize(requests.size());
+
+		size_t threads = pool.GetWorkerCount() + 1;
+
+		int count = (int)requests.size();
+		int grain = std::max(1, count / int(4 * threads));
+
+		// Any thread that waits on the pool can run a chunk so the number of
+		// the chunks that run at once isn't limited by the number of the workers
+		pool.ParallelFor(0, (count + grain - 1) / grain, 1, [&](int chunk)
+			{
+				std::unique_ptr<Scratch> scratch;
+
+				{
+					std::lock_guard<std::mutex> lock(m_ScratchMutex);
+
+					if (!m_FreeScratches.empty())
+					{
+						scratch = std::move(m_FreeScratches.back());
+						m_FreeScratches.pop_back();
+					}
+				}
+
+				if (!scratch)
+					scratch = std::make_unique<Scratch>();
+
+				int end = std::min(count, (chunk + 1) * grain);
+
+				for (int i = chunk * grain; i < end; i++)
+					FindPath(requests[i].start, requests[i].goal, paths[i], *scratch, dist, heuristic);
+
+				std::lock_guard<std::mutex> lock(m_ScratchMutex);
+				m_FreeScratches.push_back(std::move(scratch));
+			});
+	}
+
+	bool GridPathFinder::IsVisited(const def::vi2d& pos) const
+	{
+		return IsInside(pos) && m_Scratch.IsVisited(ToIndex(pos));
+	}
+
+	float GridPathFinder::GetLocalGoal(const def::vi2d& pos) const
+	{
+		return IsInside(pos) ? m_Scratch.GetLocalGoal(ToIndex(pos)) : INFINITY;
+	}
+
+	uint32_t GridPathFinder::GetParent(uint32_t index) const
+	{
+		return m_Scratch.GetParent(index);
+	}
+
+	std::vector<def::vi2d> GridPathFinder::GetPath() const
+	{
+		std::vector<def::vi2d> path;
+
+		if (m_Goal == NO_PARENT || !m_Scratch.IsVisited(m_Goal))
+			return path;
+
+		for (uint32_t index = m_Goal; index != NO_PARENT; index = GetParent(index))
+			path.push_back(ToPos(index));
+
+		std::reverse(path.begin(), path.end());
+		return path;
+	}
+
+	uint32_t GridPathFinder::ToIndex(const def::vi2d& pos) const
+	{
+		return pos.y * m_MapSize.x + pos.x;
+	}
+
+	def::vi2d GridPathFinder::ToPos(uint32_t index) const
+	{
+		return { int(index % m_MapSize.x), int(index / m_MapSize.x) };
+	}
+
+	int GridPathFinder::GetMapWidth() const
+	{
+		return m_MapSize.x;
+	}
+
+	int GridPathFinder::GetMapHeight() const
+	{
+		return m_MapSize.y;
+	}
+
+	def::vi2d GridPathFinder::GetMapSize() const
+	{
+		return m_MapSize;
+	}
+
+	bool GridPathFinder::IsInside(const def::vi2d& pos) const
+	{
+		return pos.x >= 0 && pos.y >= 0 && pos.x < m_MapSize.x && pos.y < m_MapSize.y;
+	}
+
+	bool GridPathFinder::IsObstacle(uint32_t index) const
+	{
+		return (m_Obstacles[index / 64] >> (index % 64)) & 1;
+	}
+
+	bool GridPathFinder::Search(uint32_t start, uint32_t goal, Scratch& scratch,
+		float (*dist)(const def::vi2d&, const def::vi2d&), float (*heuristic)(const def::vi2d&, const def::vi2d&)) const
+	{
+		scratch.Clear();
+
+		def::vi2d goalPos = ToPos(goal);
+
+		scratch.Touch(start);
+		scratch.m_LocalGoals[start] = 0.0f;
+		scratch.m_GlobalGoals[start] = heuristic(ToPos(start), goalPos);
+
+		scratch.m_OpenSet.Clear();
+		scratch.m_OpenSet.Push(start);
+
+		while (!scratch.m_OpenSet.IsEmpty())
+		{
+			uint32_t current = (uint32_t)scratch.m_OpenSet.Pop();
+			scratch.m_Stamps[current] |= 1;
+
+			if (current == goal)
+				return true;
+
+			def::vi2d currentPos = ToPos(current);
+
+			for (const auto& offset : NEIGHBOUR_OFFSETS)
+			{
+				def::vi2d pos = currentPos + offset;
+
+				if (!IsInside(pos))
+					continue;
+
+				uint32_t n = ToIndex(pos);
+
+				if (IsObstacle(n))
+					continue;
+
+				scratch.Touch(n);
+
+				if (scratch.m_Stamps[n] & 1)
+					continue;
+
+				float newGoal = scratch.m_LocalGoals[current] + dist(currentPos, pos);
+
+				if (newGoal < scratch.m_LocalGoals[n])
+				{
+					scratch.m_Parents[n] = current;
+					scratch.m_LocalGoals[n] = newGoal;
+					scratch.m_GlobalGoals[n] = newGoal + heuristic(pos, goalPos);
+
+					if (scratch.m_OpenSet.Contains(n))
+						scratch.m_OpenSet.Update(n);
+					else
+						scratch.m_OpenSet.Push(n);
+				}
+			}
+		}
+
+		return false;
+	}
+
+	bool HierarchicalPathFinder::CostCompare::operator()(size_t lhs, size_t rhs) const
+	{
+		return costs[lhs] < costs[rhs];
+	}
+
+	HierarchicalPathFinder::HierarchicalPathFinder()
+	{
+		m_ClusterSize = 0;
+		m_RefinedSegments = 0;
+	}
+
+	bool HierarchicalPathFinder::ConstructMap(const def::vi2d& size, int clusterSize)
+	{
+		if (size.x <= 0 || size.y <= 0 || clusterSize <= 1)
+			return false;
+
+		m_MapSize = size;
+		m_ClusterSize = clusterSize;
+		m_Clusters = (size + def::vi2d(clusterSize - 1, clusterSize - 1)) / clusterSize;
+
+		m_Obstacles.assign((size.x * size.y + 63) / 64, 0);
+
+		m_ClusterData.assign(m_Clusters.x * m_Clusters.y, Cluster());
+
+		for (int y = 0; y < m_Clusters.y; y++)
+			for (int x = 0; x < m_Clusters.x; x++)
+			{
+				Cluster& cluster = m_ClusterData[y * m_Clusters.x + x];
+
+				cluster.pos = def::vi2d(x, y) * clusterSize;
+				cluster.size = (size - cluster.pos).min(def::vi2d(clusterSize, clusterSize));
+				cluster.isDirty = true;
+			}
+
+		m_Nodes.clear();
+		m_FreeNodes.clear();
+
+		m_RightBorders.assign(m_ClusterData.size(), {});
+		m_BottomBorders.assign(m_ClusterData.size(), {});
+
+		m_LocalCosts.assign(clusterSize * clusterSize, INFINITY);
+		m_LocalParents.assign(clusterSize * clusterSize, -1);
+
+		m_LocalOpenSet = IndexedHeap<CostCompare>({ m_LocalCosts.data() });
+		m_LocalOpenSet.Reserve(clusterSize * clusterSize);
+
+		m_AbstractPath.clear();
+		m_RefinedSegments = 0;
+
+		return true;
+	}
+
+	void HierarchicalPathFinder::SetObstacle(const def::vi2d& pos, bool isObstacle)
+	{
+		if (pos.x < 0 || pos.y < 0 || pos.x >= m_MapSize.x || pos.y >= m_MapSize.y)
+			return;
+
+		if (IsObstacle(pos) == isObstacle)
+			return;
+
+		uint32_t index = pos.y * m_MapSize.x + pos.x;
+		uint64_t bit = 1ull << (index % 64);
+
+		if (isObstacle)
+			m_Obstacles[index / 64] |= bit;
+		else
+			m_Obstacles[index / 64] &= ~bit;
+
+		m_ClusterData[GetClusterIndex(pos)].isDirty = true;
+	}
+
+	bool HierarchicalPathFinder::IsObstacle(const def::vi2d& pos) const
+	{
+		return !IsWalkable(pos.x, pos.y);
+	}
+
+	void HierarchicalPathFinder::Rebuild()
+	{
+		std::vector<bool> isAffected(m_ClusterData.size());
+		std::vector<int> affected;
+
+		// Every cluster owns its right and its bottom border
+		std::vector<bool> isRightDirty(m_ClusterData.size());
+		std::vector<bool> isBottomDirty(m_ClusterData.size());
+
+		auto Affect = [&](int x, int y)
+			{
+				if (x < 0 || y < 0 || x >= m_Clusters.x || y >= m_Clusters.y)
+					return -1;
+
+				int index = y * m_Clusters.x + x;
+
+				if (!isAffected[index])
+				{
+					isAffected[index] = true;
+					affected.push_back(index);
+				}
+
+				return index;
+			};
+
+		// The entrances on all 4 borders of a changed cluster are rebuilt
+		// so the edges of its neighbours have to be rebuilt too
+		for (int y = 0; y < m_Clusters.y; y++)
+			for (int x = 0; x < m_Clusters.x; x++)
+			{
+				int index = y * m_Clusters.x + x;
+
+				if (!m_ClusterData[index].isDirty)
+					continue;
+
+				m_ClusterData[index].isDirty = false;
+
+				Affect(x, y);
+				Affect(x + 1, y);
+				Affect(x, y + 1);
+
+				if (x + 1 < m_Clusters.x) isRightDirty[index] = true;
+				if (y + 1 < m_Clusters.y) isBottomDirty[index] = true;
+
+				if (int left = Affect(x - 1, y); left != -1) isRightDirty[left] = true;
+				if (int top = Affect(x, y - 1); top != -1) isBottomDirty[top] = true;
+			}
+
+		for (int index : affected)
+		{
+			if (isRightDirty[index]) RemoveBorder(m_RightBorders[index]);
+			if (isBottomDirty[index]) RemoveBorder(m_BottomBorders[index]);
+		}
+
+		for (int index : affected)
+		{
+			for (int node : m_ClusterData[index].nodes)
+			{
+				auto& edges = m_Nodes[node].edges;
+
+				edges.erase(std::remove_if(edges.begin(), edges.end(),
+					[&](const Edge& edge) { return m_Nodes[edge.to].cluster == index; }), edges.end());
+			}
+		}
+
+		for (int index : affected)
+		{
+			const Cluster& cluster = m_ClusterData[index];
+
+			if (isRightDirty[index])
+				BuildBorder(m_RightBorders[index], cluster.pos + def::vi2d(cluster.size.x - 1, 0), { 0, 1 }, { 1, 0 }, cluster.size.y);
+
+			if (isBottomDirty[index])
+				BuildBorder(m_BottomBorders[index], cluster.pos + def::vi2d(0, cluster.size.y - 1), { 1, 0 }, { 0, 1 }, cluster.size.x);
+		}
+
+		for (int index : affected)
+			BuildEdges(index);
+	}
+
+	bool HierarchicalPathFinder::FindPath(const def::vi2d& start, const def::vi2d& goal)
+	{
+		m_AbstractPath.clear();
+		m_RefinedSegments = 0;
+
+		if (!IsWalkable(start.x, start.y) || !IsWalkable(goal.x, goal.y))
+			return false;
+
+		Rebuild();
+
+		int nodes = (int)m_Nodes.size();
+		int startNode = nodes;
+		int goalNode = nodes + 1;
+
+		if (m_LocalGoals.size() != size_t(nodes + 2))
+		{
+			m_LocalGoals.resize(nodes + 2);
+			m_GlobalGoals.resize(nodes + 2);
+			m_Parents.resize(nodes + 2);
+			m_GoalCosts.resize(nodes + 2);
+
+			m_OpenSet = IndexedHeap<CostCompare>({ m_GlobalGoals.data() });
+			m_OpenSet.Reserve(nodes + 2);
+		}
+
+		std::fill(m_LocalGoals.begin(), m_LocalGoals.end(), INFINITY);
+		std::fill(m_GoalCosts.begin(), m_GoalCosts.end(), INFINITY);
+		std::fill(m_Parents.begin(), m_Parents.end(), -1);
+
+		int startCluster = GetClusterIndex(start);
+		int goalCluster = GetClusterIndex(goal);
+
+		// The graph is undirected so the costs from the goal are the costs to the goal
+		SearchCluster(goalCluster, goal, -1);
+
+		for (int node : m_ClusterData[goalCluster].nodes)
+			m_GoalCosts[node] = m_LocalCosts[GetLocalIndex(goalCluster, m_Nodes[node].pos)];
+
+		SearchCluster(startCluster, start, -1);
+
+		std::vector<Edge> startEdges;
+
+		for (int node : m_ClusterData[startCluster].nodes)
+		{
+			float cost = m_LocalCosts[GetLocalIndex(startCluster, m_Nodes[node].pos)];
+
+			if (cost != INFINITY)
+				startEdges.push_back({ node, cost });
+		}
+
+		if (startCluster == goalCluster)
+		{
+			float cost = m_LocalCosts[GetLocalIndex(startCluster, goal)];
+
+			if (cost != INFINITY)
+				startEdges.push_back({ goalNode, cost });
+		}
+
+		auto Relax = [&](int from, int to, float cost)
+			{
+				float newGoal = m_LocalGoals[from] + cost;
+
+				if (newGoal < m_LocalGoals[to])
+				{
+					m_Parents[to] = from;
+					m_LocalGoals[to] = newGoal;
+					m_GlobalGoals[to] = newGoal + OctileDistance(to == goalNode ? goal : m_Nodes[to].pos, goal);
+
+					if (m_OpenSet.Contains(to))
+						m_OpenSet.Update(to);
+					else
+						m_OpenSet.Push(to);
+				}
+			};
+
+		m_OpenSet.Clear();
+
+		m_LocalGoals[startNode] = 0.0f;
+		m_GlobalGoals[startNode] = OctileDistance(start, goal);
+		m_OpenSet.Push(startNode);
+
+		while (!m_OpenSet.IsEmpty())
+		{
+			int current = (int)m_OpenSet.Pop();
+
+			if (current == goalNode)
+				break;
+
+			if (current == startNode)
+			{
+				for (const auto& edge : startEdges)
+					Relax(current, edge.to, edge.cost);
+
+				continue;
+			}
+
+			for (const auto& edge : m_Nodes[current].edges)
+				Relax(current, edge.to, edge.cost);
+
+			if (m_GoalCosts[current] != INFINITY)
+				Relax(current, goalNode, m_GoalCosts[current]);
+		}
+
+		if (m_LocalGoals[goalNode] == INFINITY)
+			return false;
+
+		for (int node = goalNode; node != -1; node = m_Parents[node])
+		{
+			if (node == goalNode) m_AbstractPath.push_back(goal);
+			else if (node == startNode) m_AbstractPath.push_back(start);
+			else m_AbstractPath.push_back(m_Nodes[node].pos);
+		}
+
+		std::reverse(m_AbstractPath.begin(), m_AbstractPath.end());
+		return true;
+	}
+
+	const std::vector<def::vi2d>& HierarchicalPathFinder::GetAbstractPath() const
+	{
+		return m_AbstractPath;
+	}
+
+	bool HierarchicalPathFinder::RefineNext(std::vector<def::vi2d>& path)
+	{
+		if (m_RefinedSegments + 1 >= m_AbstractPath.size())
+			return false;
+
+		const def::vi2d& from = m_AbstractPath[m_RefinedSegments];
+		const def::vi2d& to = m_AbstractPath[m_RefinedSegments + 1];
+
+		if (m_RefinedSegments == 0)
+			path.push_back(from);
+
+		m_RefinedSegments++;
+
+		if (from == to)
+			return true;
+
+		int cluster = GetClusterIndex(from);
+
+		// The entrances of the neighbouring clusters are next to each other
+		if (cluster != GetClusterIndex(to))
+		{
+			path.push_back(to);
+			return true;
+		}
+
+		int target = GetLocalIndex(cluster, to);
+		SearchCluster(cluster, from, target);
+
+		const Cluster& data = m_ClusterData[cluster];
+		size_t first = path.size();
+
+		for (int node = target; node != -1 && node != GetLocalIndex(cluster, from); node = m_LocalParents[node])
+			path.push_back(data.pos + def::vi2d(node % data.size.x, node / data.size.x));
+
+		std::reverse(path.begin() + first, path.end());
+		return true;
+	}
+
+	std::vector<def::vi2d> HierarchicalPathFinder::GetPath()
+	{
+		std::vector<def::vi2d> path;
+		while (RefineNext(path));
+		return path;
+	}
+
+	size_t HierarchicalPathFinder::GetAbstractNodeCount() const
+	{
+		return m_Nodes.size() - m_FreeNodes.size();
+	}
+
+	int HierarchicalPathFinder::GetMapWidth() const
+	{
+		return m_MapSize.x;
+	}
+
+	int HierarchicalPathFinder::GetMapHeight() const
+	{
+		return m_MapSize.y;
+	}
+
+	def::vi2d HierarchicalPathFinder::GetMapSize() const
+	{
+		return m_MapSize;
+	}
+
+	bool HierarchicalPathFinder::IsWalkable(int x, int y) const
+	{
+		if (x < 0 || y < 0 || x >= m_MapSize.x || y >= m_MapSize.y)
+			return false;
+
+		uint32_t index = y * m_MapSize.x + x;
+		return !((m_Obstacles[index / 64] >> (index % 64)) & 1);
+	}
+
+	int HierarchicalPathFinder::GetClusterIndex(const def::vi2d& pos) const
+	{
+		return (pos.y / m_ClusterSize) * m_Clusters.x + pos.x / m_ClusterSize;
+	}
+
+	int HierarchicalPathFinder::CreateNode(const def::vi2d& pos)
+	{
+		int index;
+
+		if (m_FreeNodes.empty())
+		{
+			index = (int)m_Nodes.size();
+			m_Nodes.push_back(AbstractNode());
+		}
+		else
+		{
+			index = m_FreeNodes.back();
+			m_FreeNodes.pop_back();
+		}
+
+		AbstractNode& node = m_Nodes[index];
+
+		node.pos = pos;
+		node.cluster = GetClusterIndex(pos);
+		node.isAlive = true;
+		node.edges.clear();
+
+		m_ClusterData[node.cluster].nodes.push_back(index);
+
+		return index;
+	}
+
+	void HierarchicalPathFinder::RemoveBorder(std::vector<int>& border)
+	{
+		for (int index : border)
+		{
+			AbstractNode& node = m_Nodes[index];
+			auto& nodes = m_ClusterData[node.cluster].nodes;
+
+			nodes.erase(std::find(nodes.begin(), nodes.end(), index));
+
+			node.isAlive = false;
+			node.edges.clear();
+
+			m_FreeNodes.push_back(index);
+		}
+
+		border.clear();
+	}
+
+	void HierarchicalPathFinder::BuildBorder(std::vector<int>& border, const def::vi2d& start, const def::vi2d& step, const def::vi2d& across, int length)
+	{
+		auto IsOpen = [&](int i)
+			{
+				def::vi2d pos = start + step * i;
+				def::vi2d other = pos + across;
+
+				return IsWalkable(pos.x, pos.y) && IsWalkable(other.x, other.y);
+			};
+
+		auto AddEntrance = [&](int i)
+			{
+				def::vi2d pos = start + step * i;
+
+				int inside = CreateNode(pos);
+				int outside = CreateNode(pos + across);
+
+				m_Nodes[inside].edges.push_back({ outside, 1.0f });
+				m_Nodes[outside].edges.push_back({ inside, 1.0f });
+
+				border.push_back(inside);
+				border.push_back(outside);
+			};
+
+		// A short opening gets one entrance in the middle and a long one gets an entrance at each end
+		for (int i = 0; i < length; )
+		{
+			if (!IsOpen(i))
+			{
+				i++;
+				continue;
+			}
+
+			int first = i;
+
+			while (i < length && IsOpen(i))
+				i++;
+
+			int last = i - 1;
+
+			if (last - first + 1 < 6)
+				AddEntrance((first + last) / 2);
+			else
+			{
+				AddEntrance(first);
+				AddEntrance(last);
+			}
+		}
+	}
+
+	void HierarchicalPathFinder::BuildEdges(int cluster)
+	{
+		const auto& nodes = m_ClusterData[cluster].nodes;
+
+		for (int from : nodes)
+		{
+			SearchCluster(cluster, m_Nodes[from].pos, -1);
+
+			for (int to : nodes)
+			{
+				if (to == from)
+					continue;
+
+				float cost = m_LocalCosts[GetLocalIndex(cluster, m_Nodes[to].pos)];
+
+				if (cost != INFINITY)
+					m_Nodes[from].edges.push_back({ to, cost });
+			}
+		}
+	}
+
+	void HierarchicalPathFinder::SearchCluster(int cluster, const def::vi2d& source, int target)
+	{
+		const Cluster& data = m_ClusterData[cluster];
+		int count = data.size.x * data.size.y;
+
+		std::fill(m_LocalCosts.begin(), m_LocalCosts.begin() + count, INFINITY);
+		std::fill(m_LocalParents.begin(), m_LocalParents.begin() + count, -1);
+
+		int sourceIndex = GetLocalIndex(cluster, source);
+
+		m_LocalCosts[sourceIndex] = 0.0f;
+
+		m_LocalOpenSet.Clear();
+		m_LocalOpenSet.Push(sourceIndex);
+
+		while (!m_LocalOpenSet.IsEmpty())
+		{
+			int current = (int)m_LocalOpenSet.Pop();
+
+			if (current == target)
+				break;
+
+			def::vi2d pos = data.pos + def::vi2d(current % data.size.x, current / data.size.x);
+
+			for (int i = 0; i < 8; i++)
+			{
+				def::vi2d next = pos + NEIGHBOUR_OFFSETS[i];
+				def::vi2d local = next - data.pos;
+
+				if (local.x < 0 || local.y < 0 || local.x >= data.size.x || local.y >= data.size.y || !IsWalkable(next.x, next.y))
+					continue;
+
+				int index = local.y * data.size.x + local.x;
+				float cost = m_LocalCosts[current] + NEIGHBOUR_COSTS[i];
+
+				if (cost < m_LocalCosts[index])
+				{
+					m_LocalCosts[index] = cost;
+					m_LocalParents[index] = current;
+
+					if (m_LocalOpenSet.Contains(index))
+						m_LocalOpenSet.Update(index);
+					else
+						m_LocalOpenSet.Push(index);
+				}
+			}
+		}
+	}
+
+	int HierarchicalPathFinder::GetLocalIndex(int cluster, const def::vi2d& pos) const
+	{
+		const Cluster& data = m_ClusterData[cluster];
+		return (pos.y - data.pos.y) * data.size.x + (pos.x - data.pos.x);
+	}
+
+	bool FlowField::CostCompare::operator()(size_t lhs, size_t rhs) const
+	{
+		return costs[lhs] < costs[rhs];
+	}
+
+	FlowField::FlowField()
+	{
+		m_IsBuilt = false;
+	}
+
+	bool FlowField::ConstructMap(const def::vi2d& size)
+	{
+		if (size.x <= 0 || size.y <= 0)
+			return false;
+
+		m_MapSize = size;
+
+		size_t count = size.x * size.y;
+
+		m_Obstacles.assign((count + 63) / 64, 0);
+		m_Costs.assign(count, INFINITY);
+		m_Directions.assign(count, NO_DIRECTION);
+		m_IsGoal.assign(count, 0);
+
+		m_Goals.clear();
+		m_Changed.clear();
+
+		m_OpenSet = IndexedHeap<CostCompare>({ m_Costs.data() });
+		m_OpenSet.Reserve(count);
+
+		m_IsBuilt = false;
+
+		return true;
+	}
+
+	void FlowField::SetObstacle(const def::vi2d& pos, bool isObstacle)
+	{
+		if (!IsInside(pos))
+			return;
+
+		uint32_t index = pos.y * m_MapSize.x + pos.x;
+
+		if (IsObstacle(index) == isObstacle)
+			return;
+
+		uint64_t bit = 1ull << (index % 64);
+
+		if (isObstacle)
+			m_Obstacles[index / 64] |= bit;
+		else
+			m_Obstacles[index / 64] &= ~bit;
+
+		m_Changed.push_back(index);
+	}
+
+	bool FlowField::IsObstacle(const def::vi2d& pos) const
+	{
+		return !IsInside(pos) || IsObstacle(uint32_t(pos.y * m_MapSize.x + pos.x));
+	}
+
+	void FlowField::SetObstacles(PathFinder& pathFinder)
+	{
+		if (pathFinder.GetMapSize() != m_MapSize)
+			return;
+
+		Node* nodes = pathFinder.GetNodes();
+
+		for (int y = 0; y < m_MapSize.y; y++)
+			for (int x = 0; x < m_MapSize.x; x++)
+				SetObstacle({ x, y }, nodes[y * m_MapSize.x + x].isObstacle);
+	}
+
+	void FlowField::AddGoal(const def::vi2d& pos)
+	{
+		if (!IsInside(pos))
+			return;
+
+		uint32_t index = pos.y * m_MapSize.x + pos.x;
+
+		if (m_IsGoal[index])
+			return;
+
+		m_IsGoal[index] = 1;
+		m_Goals.push_back(index);
+
+		m_IsBuilt = false;
+	}
+
+	void FlowField::ClearGoals()
+	{
+		for (uint32_t goal : m_Goals)
+			m_IsGoal[goal] = 0;
+
+		m_Goals.clear();
+		m_IsBuilt = false;
+	}
+
+	void FlowField::Build()
+	{
+		std::fill(m_Costs.begin(), m_Costs.end(), INFINITY);
+		std::fill(m_Directions.begin(), m_Directions.end(), NO_DIRECTION);
+
+		m_OpenSet.Clear();
+
+		for (uint32_t goal : m_Goals)
+		{
+			if (!IsObstacle(goal))
+			{
+				m_Costs[goal] = 0.0f;
+				m_OpenSet.Push(goal);
+			}
+		}
+
+		Flood();
+
+		m_Changed.clear();
+		m_IsBuilt = true;
+	}
+
+	void FlowField::Update()
+	{
+		if (!m_IsBuilt)
+		{
+			Build();
+			return;
+		}
+
+		// The cells that have lost their cost, they are flooded again from the valid cells around them
+		std::vector<uint32_t> invalid;
+		std::vector<uint32_t> stack;
+
+		for (uint32_t index : m_Changed)
+		{
+			invalid.push_back(index);
+
+			if (IsObstacle(index) && m_Costs[index] != INFINITY)
+			{
+				m_Costs[index] = INFINITY;
+				m_Directions[index] = NO_DIRECTION;
+				stack.push_back(index);
+			}
+		}
+
+		// Every cell whose direction leads through a blocked cell has to find a new way
+		while (!stack.empty())
+		{
+			uint32_t current = stack.back();
+			stack.pop_back();
+
+			def::vi2d pos = { int(current % m_MapSize.x), int(current / m_MapSize.x) };
+
+			for (int i = 0; i < 8; i++)
+			{
+				def::vi2d next = pos + NEIGHBOUR_OFFSETS[i];
+
+				if (!IsInside(next))
+					continue;
+
+				uint32_t n = next.y * m_MapSize.x + next.x;
+
+				// The direction from the neighbour back to this cell is the opposite offset
+				if (m_Directions[n] != (i ^ 1))
+					continue;
+
+				m_Costs[n] = INFINITY;
+				m_Directions[n] = NO_DIRECTION;
+
+				stack.push_back(n);
+				invalid.push_back(n);
+			}
+		}
+
+		m_OpenSet.Clear();
+
+		for (uint32_t index : invalid)
+		{
+			if (IsObstacle(index) || m_OpenSet.Contains(index))
+				continue;
+
+			if (m_IsGoal[index])
+			{
+				m_Costs[index] = 0.0f;
+				m_Directions[index] = NO_DIRECTION;
+				m_OpenSet.Push(index);
+				continue;
+			}
+
+			def::vi2d pos = { int(index % m_MapSize.x), int(index / m_MapSize.x) };
+
+			for (int i = 0; i < 8; i++)
+			{
+				def::vi2d next = pos + NEIGHBOUR_OFFSETS[i];
+
+				if (!IsInside(next))
+					continue;
+
+				float cost = m_Costs[next.y * m_MapSize.x + next.x] + NEIGHBOUR_COSTS[i];
+
+				if (cost < m_Costs[index])
+				{
+					m_Costs[index] = cost;
+					m_Directions[index] = i;
+				}
+			}
+
+			if (m_Costs[index] != INFINITY)
+				m_OpenSet.Push(index);
+		}
+
+		Flood();
+
+		m_Changed.clear();
+	}
+
+	float FlowField::GetCost(const def::vi2d& pos) const
+	{
+		return IsInside(pos) ? m_Costs[pos.y * m_MapSize.x + pos.x] : INFINITY;
+	}
+
+	def::vi2d FlowField::GetDirection(const def::vi2d& pos) const
+	{
+		if (!IsInside(pos))
+			return { 0, 0 };
+
+		uint8_t direction = m_Directions[pos.y * m_MapSize.x + pos.x];
+		return direction == NO_DIRECTION ? def::vi2d(0, 0) : NEIGHBOUR_OFFSETS[direction];
+	}
+
+	int FlowField::GetMapWidth() const
+	{
+		return m_MapSize.x;
+	}
+
+	int FlowField::GetMapHeight() const
+	{
+		return m_MapSize.y;
+	}
+
+	def::vi2d FlowField::GetMapSize() const
+	{
+		return m_MapSize;
+	}
+
+	bool FlowField::IsInside(const def::vi2d& pos) const
+	{
+		return pos.x >= 0 && pos.y >= 0 && pos.x < m_MapSize.x && pos.y < m_MapSize.y;
+	}
+
+	bool FlowField::IsObstacle(uint32_t index) const
+	{
+		return (m_Obstacles[index / 64] >> (index % 64)) & 1;
+	}
+
+	void FlowField::Flood()
+	{
+		while (!m_OpenSet.IsEmpty())
+		{
+			uint32_t current = (uint32_t)m_OpenSet.Pop();
+			def::vi2d pos = { int(current % m_MapSize.x), int(current / m_MapSize.x) };
+
+			for (int i = 0; i < 8; i++)
+			{
+				def::vi2d next = pos + NEIGHBOUR_OFFSETS[i];
+
+				if (!IsInside(next))
+					continue;
+
+				uint32_t n = next.y * m_MapSize.x + next.x;
+
+				if (IsObstacle(n))
+					continue;
+
+				float cost = m_Costs[current] + NEIGHBOUR_COSTS[i];
+
+				if (cost < m_Costs[n])
+				{
+					m_Costs[n] = cost;
+
+					// The neighbour steps back along the opposite offset
+					m_Directions[n] = i ^ 1;
+
+					if (m_OpenSet.Contains(n))
+						m_OpenSet.Update(n);
+					else
+						m_OpenSet.Push(n);
+				}
+			}
+		}
+	}
+
+	bool IncrementalPathFinder::KeyCompare::operator()(size_t lhs, size_t rhs) const
+	{
+		if (primaryKeys[lhs] == primaryKeys[rhs])
+			return secondaryKeys[lhs] < secondaryKeys[rhs];
+
+		return primaryKeys[lhs] < primaryKeys[rhs];
+	}
+
+	IncrementalPathFinder::IncrementalPathFinder()
+	{
+		m_Start = NO_NODE;
+		m_Goal = NO_NODE;
+		m_LastStart = NO_NODE;
+
+		m_KeyModifier = 0;
+		m_ExpandedCount = 0;
+	}
+
+	bool IncrementalPathFinder::ConstructMap(const def::vi2d& size)
+	{
+		if (size.x <= 0 || size.y <= 0)
+			return false;
+
+		m_MapSize = size;
+
+		size_t count = size.x * size.y;
+
+		m_Obstacles.assign((count + 63) / 64, 0);
+
+		m_Goals.assign(count, INFINITE_COST);
+		m_Lookaheads.assign(count, INFINITE_COST);
+
+		m_PrimaryKeys.assign(count, 0);
+		m_SecondaryKeys.assign(count, 0);
+
+		m_OpenSet = IndexedHeap<KeyCompare>({ m_PrimaryKeys.data(), m_SecondaryKeys.data() });
+		m_OpenSet.Reserve(count);
+
+		m_Start = NO_NODE;
+		m_Goal = NO_NODE;
+		m_LastStart = NO_NODE;
+
+		m_KeyModifier = 0;
+		m_ExpandedCount = 0;
+
+		return true;
+	}
+
+	void IncrementalPathFinder::SetObstacle(const def::vi2d& pos, bool isObstacle)
+	{
+		if (!IsInside(pos))
+			return;
+
+		uint32_t index = pos.y * m_MapSize.x + pos.x;
+
+		if (IsObstacle(index) == isObstacle)
+			return;
+
+		uint64_t bit = 1ull << (index % 64);
+
+		if (isObstacle)
+			m_Obstacles[index / 64] |= bit;
+		else
+			m_Obstacles[index / 64] &= ~bit;
+
+		if (m_Goal == NO_NODE)
+			return;
+
+		// The costs of all of the edges of the node have changed
+		uint32_t neighbours[8];
+		int count = GetNeighbours(index, neighbours);
+
+		UpdateLookahead(index);
+		UpdateNode(index);
+
+		for (int i = 0; i < count; i++)
+		{
+			UpdateLookahead(neighbours[i]);
+			UpdateNode(neighbours[i]);
+		}
+	}
+
+	bool IncrementalPathFinder::IsObstacle(const def::vi2d& pos) const
+	{
+		return !IsInside(pos) || IsObstacle(uint32_t(pos.y * m_MapSize.x + pos.x));
+	}
+
+	bool IncrementalPathFinder::SetGoal(const def::vi2d& pos)
+	{
+		if (!IsInside(pos))
+			return false;
+
+		m_Goal = pos.y * m_MapSize.x + pos.x;
+
+		std::fill(m_Goals.begin(), m_Goals.end(), INFINITE_COST);
+		std::fill(m_Lookaheads.begin(), m_Lookaheads.end(), INFINITE_COST);
+
+		m_OpenSet.Clear();
+
+		m_KeyModifier = 0;
+		m_LastStart = m_Start;
+
+		m_Lookaheads[m_Goal] = 0;
+		UpdateNode(m_Goal);
+
+		return true;
+	}
+
+	bool IncrementalPathFinder::SetStart(const def::vi2d& pos)
+	{
+		if (!IsInside(pos))
+			return false;
+
+		m_Start = pos.y * m_MapSize.x + pos.x;
+
+		// Instead of updating all of the keys in the open set the new keys are raised
+		// by the distance the start has moved so the old keys stay their lower bounds
+		if (m_LastStart != NO_NODE)
+			m_KeyModifier += Heuristic(m_LastStart, m_Start);
+
+		m_LastStart = m_Start;
+
+		return true;
+	}
+
+	bool IncrementalPathFinder::FindPath()
+	{
+		m_ExpandedCount = 0;
+
+		if (m_Start == NO_NODE || m_Goal == NO_NODE)
+			return false;
+
+		uint32_t neighbours[8];
+
+		int64_t startPrimary;
+		int32_t startSecondary;
+
+		CalculateKey(m_Start, startPrimary, startSecondary);
+
+		while (!m_OpenSet.IsEmpty())
+		{
+			uint32_t current = (uint32_t)m_OpenSet.Top();
+
+			int64_t oldPrimary = m_PrimaryKeys[current];
+			int32_t oldSecondary = m_SecondaryKeys[current];
+
+			bool isStartConsistent = m_Lookaheads[m_Start] == m_Goals[m_Start];
+			bool isTopBelowStart = oldPrimary < startPrimary || (oldPrimary == startPrimary && oldSecondary < startSecondary);
+
+			if (!isTopBelowStart && isStartConsistent)
+				break;
+
+			int64_t newPrimary;
+			int32_t newSecondary;
+
+			CalculateKey(current, newPrimary, newSecondary);
+
+			m_ExpandedCount++;
+
+			if (oldPrimary < newPrimary || (oldPrimary == newPrimary && oldSecondary < newSecondary))
+			{
+				m_PrimaryKeys[current] = newPrimary;
+				m_SecondaryKeys[current] = newSecondary;
+				m_OpenSet.Reposition(current);
+			}
+			else if (m_Goals[current] > m_Lookaheads[current])
+			{
+				m_Goals[current] = m_Lookaheads[current];
+				m_OpenSet.Remove(current);
+
+				int count = GetNeighbours(current, neighbours);
+
+				for (int i = 0; i < count; i++)
+				{
+					uint32_t n = neighbours[i];
+
+					if (n != m_Goal)
+						m_Lookaheads[n] = std::min(m_Lookaheads[n], AddCosts(Cost(n, current), m_Goals[current]));
+
+					UpdateNode(n);
+				}
+			}
+			else
+			{
+				int32_t oldGoal = m_Goals[current];
+				m_Goals[current] = INFINITE_COST;
+
+				int count = GetNeighbours(current, neighbours);
+
+				// The nodes that were using the old cost have to find another way
+				for (int i = 0; i < count; i++)
+				{
+					uint32_t n = neighbours[i];
+
+					if (n != m_Goal && m_Lookaheads[n] == AddCosts(Cost(n, current), oldGoal))
+						UpdateLookahead(n);
+
+					UpdateNode(n);
+				}
+
+				UpdateLookahead(current);
+				UpdateNode(current);
+			}
+
+			CalculateKey(m_Start, startPrimary, startSecondary);
+		}
+
+		return m_Goals[m_Start] != INFINITE_COST;
+	}
+
+	std::vector<def::vi2d> IncrementalPathFinder::GetPath() const
+	{
+		std::vector<def::vi2d> path;
 
-	private:
-		def::vi2d m_MapSize;
+		if (m_Start == NO_NODE || m_Goal == NO_NODE || m_Goals[m_Start] == INFINITE_COST)
+			return path;
 
-		Node* m_Nodes;
+		uint32_t neighbours[8];
+		uint32_t current = m_Start;
 
-		Node* m_Start;
-		Node* m_Goal;
+		path.push_back(ToPos(current));
 
-		bool m_IsMapFreed;
+		// The costs are consistent after FindPath so following the cheapest
+		// neighbour always leads to the goal, the limit only guards against misuse
+		for (size_t steps = 0; current != m_Goal && steps < m_Goals.size(); steps++)
+		{
+			int count = GetNeighbours(current, neighbours);
 
-	public:
-		void ClearMap();
-		bool FreeMap();
-		bool ConstructMap(const def::vi2d& size);
+			uint32_t next = NO_NODE;
+			int32_t best = INFINITE_COST;
 
-		bool SetNodes(const def::vi2d& start, const def::vi2d& goal);
-		void SetNodes(Node* start = nullptr, Node* goal = nullptr);
+			for (int i = 0; i < count; i++)
+			{
+				int32_t cost = AddCosts(Cost(current, neighbours[i]), m_Goals[neighbours[i]]);
 
-		Node* GetStartNode();
-		Node* GetGoalNode();
-		Node* GetNodes();
+				if (cost < best)
+				{
+					best = cost;
+					next = neighbours[i];
+				}
+			}
 
-		void ResetNodes();
+			if (next == NO_NODE)
+			{
+				path.clear();
+				break;
+			}
 
-		int GetMapWidth() const;
-		int GetMapHeight() const;
-		def::vi2d GetMapSize() const;
+			current = next;
+			path.push_back(ToPos(current));
+		}
 
-		void FindPath(float (*dist)(Node*, Node*), float (*heuristic)(Node*, Node*));
+		return path;
+	}
 
-	};
+	float IncrementalPathFinder::GetCost(const def::vi2d& pos) const
+	{
+		if (!IsInside(pos))
+			return INFINITY;
 
-#ifdef DGE_PATHFINDER
-#undef DGE_PATHFINDER
+		int32_t cost = m_Goals[pos.y * m_MapSize.x + pos.x];
+		return cost == INFINITE_COST ? INFINITY : float(cost) / float(STRAIGHT_COST);
+	}
+
+	size_t IncrementalPathFinder::GetExpandedCount() const
+	{
+		return m_ExpandedCount;
+	}
+
+	int IncrementalPathFinder::GetMapWidth() const
+	{
+		return m_MapSize.x;
+	}
+
+	int IncrementalPathFinder::GetMapHeight() const
+	{
+		return m_MapSize.y;
+	}
+
+	def::vi2d IncrementalPathFinder::GetMapSize() const
+	{
+		return m_MapSize;
+	}
+
+	bool IncrementalPathFinder::IsInside(const def::vi2d& pos) const
+	{
+		return pos.x >= 0 && pos.y >= 0 && pos.x < m_MapSize.x && pos.y < m_MapSize.y;
+	}
+
+	bool IncrementalPathFinder::IsObstacle(uint32_t index) const
+	{
+		return (m_Obstacles[index / 64] >> (index % 64)) & 1;
+	}
+
+	def::vi2d IncrementalPathFinder::ToPos(uint32_t index) const
+	{
+		return { int(index % m_MapSize.x), int(index / m_MapSize.x) };
+	}
+
+	int32_t IncrementalPathFinder::Heuristic(uint32_t lhs, uint32_t rhs) const
+	{
+		def::vi2d delta = (ToPos(lhs) - ToPos(rhs)).abs();
+
+		int diagonal = std::min(delta.x, delta.y);
+		int straight = std::max(delta.x, delta.y) - diagonal;
+
+		return straight * STRAIGHT_COST + diagonal * DIAGONAL_COST;
+	}
+
+	int32_t IncrementalPathFinder::Cost(uint32_t from, uint32_t to) const
+	{
+		if (IsObstacle(from) || IsObstacle(to))
+			return INFINITE_COST;
+
+		def::vi2d delta = ToPos(from) - ToPos(to);
+		return (delta.x != 0 && delta.y != 0) ? DIAGONAL_COST : STRAIGHT_COST;
+	}
+
+	int32_t IncrementalPathFinder::AddCosts(int32_t lhs, int32_t rhs) const
+	{
+		if (lhs == INFINITE_COST || rhs == INFINITE_COST)
+			return INFINITE_COST;
+
+		return lhs + rhs;
+	}
+
+	int IncrementalPathFinder::GetNeighbours(uint32_t index, uint32_t* neighbours) const
+	{
+		def::vi2d pos = ToPos(index);
+		int count = 0;
+
+		for (const auto& offset : NEIGHBOUR_OFFSETS)
+		{
+			def::vi2d next = pos + offset;
+
+			if (IsInside(next))
+				neighbours[count++] = next.y * m_MapSize.x + next.x;
+		}
+
+		return count;
+	}
+
+	void IncrementalPathFinder::CalculateKey(uint32_t index, int64_t& primary, int32_t& secondary) const
+	{
+		secondary = std::min(m_Goals[index], m_Lookaheads[index]);
+		primary = int64_t(secondary) + m_KeyModifier;
+
+		// Without a start the key is still a lower bound and is raised when the node is expanded
+		if (m_Start != NO_NODE)
+			primary += Heuristic(m_Start, index);
+	}
+
+	void IncrementalPathFinder::UpdateLookahead(uint32_t index)
+	{
+		if (index == m_Goal)
+			return;
+
+		uint32_t neighbours[8];
+		int count = GetNeighbours(index, neighbours);
+
+		int32_t lookahead = INFINITE_COST;
+
+		for (int i = 0; i < count; i++)
+			lookahead = std::min(lookahead, AddCosts(Cost(index, neighbours[i]), m_Goals[neighbours[i]]));
+
+		m_Lookaheads[index] = lookahead;
+	}
+
+	void IncrementalPathFinder::UpdateNode(uint32_t index)
+	{
+		bool isInOpenSet = m_OpenSet.Contains(index);
+
+		if (m_Goals[index] == m_Lookaheads[index])
+		{
+			if (isInOpenSet)
+				m_OpenSet.Remove(index);
+
+			return;
+		}
+
+		CalculateKey(index, m_PrimaryKeys[index], m_SecondaryKeys[index]);
+
+		if (isInOpenSet)
+			m_OpenSet.Reposition(index);
+		else
+			m_OpenSet.Push(index);
+	}
 
 	Node::Node()
 	{
@@ -112,6 +2383,8 @@ namespace def
 
 	PathFinder::PathFinder()
 	{
+		m_Nodes = nullptr;
+
 		m_Start = nullptr;
 		m_Goal = nullptr;
 
@@ -125,8 +2398,8 @@ namespace def
 
 	void PathFinder::ClearMap()
 	{
-		for (int x = 0; x < m_MapSize.x; x++)
-			for (int y = 0; y < m_MapSize.y; y++)
+		for (int y = 0; y < m_MapSize.y; y++)
+			for (int x = 0; x < m_MapSize.x; x++)
 			{
 				int p = y * m_MapSize.x + x;
 
@@ -149,6 +2422,9 @@ namespace def
 			m_IsMapFreed = true;
 		}
 
+		// The distances are computed for the map that was freed
+		m_JumpDistances.clear();
+
 		return m_IsMapFreed;
 	}
 
@@ -164,10 +2440,13 @@ namespace def
 
 		m_Nodes = new Node[size.x * size.y];
 
+		m_OpenSet = IndexedHeap<NodeCompare>({ m_Nodes });
+		m_OpenSet.Reserve(size.x * size.y);
+
 		ClearMap();
 
-		for (int x = 0; x < size.x; x++)
-			for (int y = 0; y < size.y; y++)
+		for (int y = 0; y < size.y; y++)
+			for (int x = 0; x < size.x; x++)
 			{
 				bool topFits = y > 0;
 				bool bottomFits = y < size.y - 1;
@@ -256,34 +2535,307 @@ namespace def
 		return m_MapSize;
 	}
 
-	void PathFinder::FindPath(float (*dist)(Node*, Node*), float (*heuristic)(Node*, Node*))
+	bool PathFinder::IsWalkable(int x, int y) const
+	{
+		return x >= 0 && y >= 0 && x < m_MapSize.x && y < m_MapSize.y && !m_Nodes[y * m_MapSize.x + x].isObstacle;
+	}
+
+	Node* PathFinder::GetNode(int x, int y)
+	{
+		return &m_Nodes[y * m_MapSize.x + x];
+	}
+
+	int PathFinder::GetJumpDirections(Node* node, def::vi2d* directions) const
+	{
+		int count = 0;
+
+		if (!node->parent)
+		{
+			for (int dy = -1; dy <= 1; dy++)
+				for (int dx = -1; dx <= 1; dx++)
+				{
+					if (dx != 0 || dy != 0)
+						directions[count++] = { dx, dy };
+				}
+
+			return count;
+		}
+
+		int x = node->pos.x, y = node->pos.y;
+
+		int dx = (x > node->parent->pos.x) - (x < node->parent->pos.x);
+		int dy = (y > node->parent->pos.y) - (y < node->parent->pos.y);
+
+		if (dx != 0 && dy != 0)
+		{
+			directions[count++] = { dx, 0 };
+			directions[count++] = { 0, dy };
+			directions[count++] = { dx, dy };
+
+			if (!IsWalkable(x - dx, y)) directions[count++] = { -dx, dy };
+			if (!IsWalkable(x, y - dy)) directions[count++] = { dx, -dy };
+		}
+		else if (dx != 0)
+		{
+			directions[count++] = { dx, 0 };
+
+			if (!IsWalkable(x, y + 1)) directions[count++] = { dx, 1 };
+			if (!IsWalkable(x, y - 1)) directions[count++] = { dx, -1 };
+		}
+		else
+		{
+			directions[count++] = { 0, dy };
+
+			if (!IsWalkable(x + 1, y)) directions[count++] = { 1, dy };
+			if (!IsWalkable(x - 1, y)) directions[count++] = { -1, dy };
+		}
+
+		return count;
+	}
+
+	bool PathFinder::IsForced(int x, int y, int dx, int dy) const
+	{
+		// Diagonal moves are allowed next to obstacles just like in ConstructMap
+		if (dx != 0 && dy != 0)
+		{
+			return
+				(!IsWalkable(x - dx, y) && IsWalkable(x - dx, y + dy)) ||
+				(!IsWalkable(x, y - dy) && IsWalkable(x + dx, y - dy));
+		}
+
+		if (dx != 0)
+		{
+			return
+				(!IsWalkable(x, y + 1) && IsWalkable(x + dx, y + 1)) ||
+				(!IsWalkable(x, y - 1) && IsWalkable(x + dx, y - 1));
+		}
+
+		return
+			(!IsWalkable(x + 1, y) && IsWalkable(x + 1, y + dy)) ||
+			(!IsWalkable(x - 1, y) && IsWalkable(x - 1, y + dy));
+	}
+
+	Node* PathFinder::Jump(int x, int y, int dx, int dy)
+	{
+		while (true)
+		{
+			x += dx;
+			y += dy;
+
+			if (!IsWalkable(x, y))
+				return nullptr;
+
+			Node* node = GetNode(x, y);
+
+			if (node == m_Goal || IsForced(x, y, dx, dy))
+				return node;
+
+			if (dx != 0 && dy != 0 && (Jump(x, y, dx, 0) || Jump(x, y, 0, dy)))
+				return node;
+		}
+	}
+
+	int& PathFinder::JumpDistance(int x, int y, int dx, int dy)
+	{
+		int direction = (dy + 1) * 3 + dx + 1;
+
+		if (direction > 4)
+			direction--;
+
+		return m_JumpDistances[(y * m_MapSize.x + x) * 8 + direction];
+	}
+
+	void PathFinder::PrecomputeJumpPoints()
+	{
+		m_JumpDistances.assign(m_MapSize.x * m_MapSize.y * 8, 0);
+
+		auto Fill = [&](int dx, int dy)
+			{
+				// Every node needs the distance of the next one in the direction
+				int startX = dx > 0 ? m_MapSize.x - 1 : 0, stepX = dx > 0 ? -1 : 1;
+				int startY = dy > 0 ? m_MapSize.y - 1 : 0, stepY = dy > 0 ? -1 : 1;
+
+				for (int y = startY; y >= 0 && y < m_MapSize.y; y += stepY)
+					for (int x = startX; x >= 0 && x < m_MapSize.x; x += stepX)
+					{
+						int nx = x + dx, ny = y + dy;
+
+						if (!IsWalkable(x, y) || !IsWalkable(nx, ny))
+							continue;
+
+						bool isJumpPoint = IsForced(nx, ny, dx, dy);
+
+						if (dx != 0 && dy != 0)
+							isJumpPoint = isJumpPoint || JumpDistance(nx, ny, dx, 0) > 0 || JumpDistance(nx, ny, 0, dy) > 0;
+
+						int next = JumpDistance(nx, ny, dx, dy);
+						JumpDistance(x, y, dx, dy) = isJumpPoint ? 1 : (next > 0 ? next + 1 : next - 1);
+					}
+			};
+
+		Fill(1, 0); Fill(-1, 0); Fill(0, 1); Fill(0, -1);
+		Fill(1, 1); Fill(-1, 1); Fill(1, -1); Fill(-1, -1);
+	}
+
+	template <class Successors>
+	void PathFinder::SearchJumpPoints(float (*heuristic)(Node*, Node*), Successors&& successors)
 	{
 		Node* current = m_Start;
 		current->localGoal = 0.0f;
 		current->globalGoal = heuristic(current, m_Goal);
 
-		std::list<Node*> nodesToTest;
-		nodesToTest.push_back(current);
+		m_OpenSet.Clear();
+		m_OpenSet.Push(current - m_Nodes);
 
-		while (!nodesToTest.empty() && current != m_Goal)
+		while (!m_OpenSet.IsEmpty())
 		{
-			nodesToTest.sort(
-				[](const Node* lhs, const Node* rhs) {
-					return lhs->globalGoal < rhs->globalGoal;
+			current = &m_Nodes[m_OpenSet.Pop()];
+			current->isVisited = true;
+
+			if (current == m_Goal)
+				break;
+
+			successors(current, [&](Node* n)
+				{
+					if (n->isVisited)
+						return;
+
+					float newGoal = current->localGoal + OctileDistance(current->pos, n->pos);
+
+					if (newGoal < n->localGoal)
+					{
+						n->parent = current;
+						n->localGoal = newGoal;
+						n->globalGoal = n->localGoal + heuristic(n, m_Goal);
+
+						size_t index = n - m_Nodes;
+
+						if (m_OpenSet.Contains(index))
+							m_OpenSet.Update(index);
+						else
+							m_OpenSet.Push(index);
+					}
 				});
+		}
+
+		if (!m_Goal->isVisited)
+			return;
+
+		// Links the nodes between the jump points so the path can be followed step by step
+		for (Node* node = m_Goal; node->parent; )
+		{
+			Node* jumpPoint = node->parent;
+
+			int dx = (jumpPoint->pos.x > node->pos.x) - (jumpPoint->pos.x < node->pos.x);
+			int dy = (jumpPoint->pos.y > node->pos.y) - (jumpPoint->pos.y < node->pos.y);
+
+			float step = (dx != 0 && dy != 0) ? 1.41421356f : 1.0f;
+
+			while (node->pos + def::vi2d(dx, dy) != jumpPoint->pos)
+			{
+				Node* next = GetNode(node->pos.x + dx, node->pos.y + dy);
+
+				next->localGoal = node->localGoal - step;
+				node->parent = next;
+				node = next;
+			}
+
+			node->parent = jumpPoint;
+			node = jumpPoint;
+		}
+	}
+
+	void PathFinder::FindPathJPS(float (*heuristic)(Node*, Node*))
+	{
+		SearchJumpPoints(heuristic, [&](Node* current, auto&& add)
+			{
+				def::vi2d directions[8];
+				int count = GetJumpDirections(current, directions);
+
+				for (int i = 0; i < count; i++)
+				{
+					if (Node* n = Jump(current->pos.x, current->pos.y, directions[i].x, directions[i].y))
+						add(n);
+				}
+			});
+	}
+
+	void PathFinder::FindPathJPSPlus(float (*heuristic)(Node*, Node*))
+	{
+		if (m_JumpDistances.size() != size_t(m_MapSize.x * m_MapSize.y * 8))
+			PrecomputeJumpPoints();
+
+		SearchJumpPoints(heuristic, [&](Node* current, auto&& add)
+			{
+				def::vi2d directions[8];
+				int count = GetJumpDirections(current, directions);
+
+				int x = current->pos.x, y = current->pos.y;
+
+				int goalX = m_Goal->pos.x - x;
+				int goalY = m_Goal->pos.y - y;
+
+				for (int i = 0; i < count; i++)
+				{
+					int dx = directions[i].x, dy = directions[i].y;
+
+					if (!IsWalkable(x + dx, y + dy))
+						continue;
+
+					int dist = JumpDistance(x, y, dx, dy);
+					int reach = abs(dist);
+
+					if (dx != 0 && dy != 0)
+					{
+						// A node on the diagonal is a jump point if the goal is straight from it
+						bool isTowardsGoal = (goalX > 0) - (goalX < 0) == dx && (goalY > 0) - (goalY < 0) == dy;
+						int steps = std::min(abs(goalX), abs(goalY));
 
-			while (!nodesToTest.empty() && nodesToTest.front()->isVisited)
-				nodesToTest.pop_front();
+						if (isTowardsGoal && steps <= reach)
+							add(GetNode(x + dx * steps, y + dy * steps));
 
-			if (nodesToTest.empty()) break;
+						else if (dist > 0)
+							add(GetNode(x + dx * dist, y + dy * dist));
+					}
+					else
+					{
+						bool isOnLine = dx != 0 ?
+							(goalY == 0 && (goalX > 0) - (goalX < 0) == dx) :
+							(goalX == 0 && (goalY > 0) - (goalY < 0) == dy);
 
-			current = nodesToTest.front();
+						int steps = abs(goalX) + abs(goalY);
+
+						if (isOnLine && steps <= reach)
+							add(m_Goal);
+
+						else if (dist > 0)
+							add(GetNode(x + dx * dist, y + dy * dist));
+					}
+				}
+			});
+	}
+
+	void PathFinder::FindPath(float (*dist)(Node*, Node*), float (*heuristic)(Node*, Node*))
+	{
+		Node* current = m_Start;
+		current->localGoal = 0.0f;
+		current->globalGoal = heuristic(current, m_Goal);
+
+		m_OpenSet.Clear();
+		m_OpenSet.Push(current - m_Nodes);
+
+		while (!m_OpenSet.IsEmpty())
+		{
+			current = &m_Nodes[m_OpenSet.Pop()];
 			current->isVisited = true;
 
+			if (current == m_Goal)
+				break;
+
 			for (auto& n : current->neighbours)
 			{
-				if (!n->isVisited && !n->isObstacle)
-					nodesToTest.push_back(n);
+				if (n->isVisited || n->isObstacle)
+					continue;
 
 				float newGoal = current->localGoal + dist(current, n);
 
@@ -292,6 +2844,13 @@ namespace def
 					n->parent = current;
 					n->localGoal = newGoal;
 					n->globalGoal = n->localGoal + heuristic(n, m_Goal);
+
+					size_t index = n - m_Nodes;
+
+					if (m_OpenSet.Contains(index))
+						m_OpenSet.Update(index);
+					else
+						m_OpenSet.Push(index);
 				}
 			}
 		}
@@ -81,13 +81,25 @@
 #include <algorithm>
 #include <functional>
 #include <list>
-
-#define PLATFORM_GL
-
-#if defined(_WIN32) && !defined(DGE_USE_GLFW3)
-	#define PLATFORM_GL_WINDOWS
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <cassert>
+
+#if defined(DGE_HEADLESS)
+	#define PLATFORM_HEADLESS
 #else
-	#define PLATFORM_GLFW3
+	#define PLATFORM_GL
+
+	#if defined(_WIN32) && !defined(DGE_USE_GLFW3)
+		#define PLATFORM_GL_WINDOWS
+	#else
+		#define PLATFORM_GLFW3
+	#endif
 #endif
 
 #ifdef PLATFORM_GLFW3
@@ -98,7 +110,6 @@
 	#include <Windows.h>
 	#include <gl/GL.h>
 	#include <dwmapi.h>
-	#include <thread>
 
 	typedef BOOL (WINAPI wglSwapInterval_t)(int interval);
 	static wglSwapInterval_t* wglSwapInterval = nullptr;
@@ -149,7 +160,7 @@ namespace def
 	template <class... T>
 	void Assert(bool expr, T&&... args);
 
-#ifdef PLATFORM_GLFW3
+#if defined(PLATFORM_GLFW3) || defined(PLATFORM_HEADLESS)
 
 	enum class Key
 	{
@@ -380,8 +391,130 @@ namespace def
 	template <class T1, class T2>
 	constexpr bool operator!=(const vec2d<T1>& v1, const vec2d<T2>& v2);
 
+	/*
+	* Structure of arrays storage for vf2d, the kernels are plain loops
+	* over contiguous floats so the compiler can vectorize them
+	*/
+	struct vf2dArray
+	{
+		vf2dArray() = default;
+		vf2dArray(size_t size);
+		vf2dArray(const std::vector<vf2d>& points);
+
+		std::vector<float> x, y;
+
+		size_t size() const;
+		void resize(size_t size);
+		void reserve(size_t size);
+		void clear();
+
+		void push_back(const vf2d& v);
+
+		vf2d get(size_t i) const;
+		void set(size_t i, const vf2d& v);
+
+		void assign(const std::vector<vf2d>& points);
+		void store(std::vector<vf2d>& points) const;
+		std::vector<vf2d> vector() const;
+
+		void translate(const vf2d& offset);
+		void scale(const vf2d& factor);
+		void rotate(float angle);
+
+		// Rotates, scales and then translates every point
+		void transform(float angle, float scale, const vf2d& offset);
+
+		void norm();
+		void lerp(const vf2dArray& target, float t);
+
+		void dot(const vf2dArray& other, std::vector<float>& out) const;
+		void length(std::vector<float>& out) const;
+	};
+
+#endif
+
+	/*
+	* 2D affine transform stored as a row-major 3x3 matrix,
+	* a * b applies b first and then a
+	*/
+	struct mat3
+	{
+		mat3();
+		mat3(float m00, float m01, float m02, float m10, float m11, float m12);
+
+		float m[3][3];
+
+		static mat3 translate(const vf2d& offset);
+		static mat3 rotate(float angle);
+		static mat3 scale(const vf2d& factor);
+
+		mat3 operator*(const mat3& rhs) const;
+		mat3& operator*=(const mat3& rhs);
+
+		vf2d operator*(const vf2d& point) const;
+
+		vf2d transform(const vf2d& point) const;
+		void transform(const vf2d* in, vf2d* out, size_t count) const;
+		void transform(std::vector<vf2d>& points) const;
+
+#ifndef DGE_IGNORE_VEC2D
+		void transform(vf2dArray& points) const;
 #endif
 
+		float det() const;
+		mat3 invert() const;
+	};
+
+	struct vf4d
+	{
+		float x = 0.0f, y = 0.0f, z = 0.0f, w = 1.0f;
+	};
+
+	/*
+	* Row-major 4x4 matrix for the software 3D pipeline, vectors are columns,
+	* the projection follows the OpenGL convention (the camera looks at -z, NDC z is in [-1, 1])
+	*/
+	struct mat4
+	{
+		mat4();
+
+		float m[4][4];
+
+		static mat4 translate(float x, float y, float z);
+		static mat4 scale(float x, float y, float z);
+
+		static mat4 rotateX(float angle);
+		static mat4 rotateY(float angle);
+		static mat4 rotateZ(float angle);
+
+		static mat4 perspective(float fovY, float aspect, float nearPlane, float farPlane);
+
+		mat4 operator*(const mat4& rhs) const;
+		mat4& operator*=(const mat4& rhs);
+
+		vf4d operator*(const vf4d& v) const;
+		void transform(const vf4d* in, vf4d* out, size_t count) const;
+	};
+
+	/*
+	* Counters of the previous frame, the times are in seconds.
+	* pixelsWritten is only counted if DGE_FRAME_STATS is defined
+	*/
+	struct FrameStats
+	{
+		float frameTime = 0.0f;
+		float updateTime = 0.0f;
+		float submitTime = 0.0f;
+		float renderTime = 0.0f;
+
+		uint32_t drawCalls = 0;
+		uint32_t textureInstances = 0;
+
+		uint64_t textureMemory = 0;
+		uint64_t uploadBytes = 0;
+		uint64_t pixelsWritten = 0;
+	};
+
 	struct KeyState
 	{
 		constexpr KeyState();
@@ -508,7 +641,13 @@ namespace def
 
 		Texture(Sprite* sprite);
 		Texture(std::string_view fileName);
+		~Texture();
 
+		Texture(const Texture&) = delete;
+		Texture& operator=(const Texture&) = delete;
+
+		// The uploads are deferred to the render thread while the rendering is pipelined,
+		// so the id stays 0 until the next frame is rendered
 		uint32_t id;
 
 		vf2d uvScale;
@@ -520,6 +659,55 @@ namespace def
 	private:
 		void Construct(Sprite* sprite, bool deleteSprite);
 
+		// Runs the upload on the render thread if the texture is still alive by then
+		void Defer(Sprite* sprite, void (Texture::*upload)(Sprite*));
+
+		// Replaces the size of the previous upload in the texture memory of the engine
+		void SetMemoryUsage(uint64_t bytes);
+
+		// Must be called on the thread that owns the context
+		static void Delete(uint32_t id);
+
+	private:
+		// Points to the texture until it's destroyed, shared with the deferred uploads
+		std::shared_ptr<Texture*> m_Self;
+
+		// Size of the uploaded pixels that is counted in the texture memory of the engine
+		uint64_t m_Bytes;
+
+	};
+
+	/*
+	* Stores depth in [0, 1] (0 is the closest) and the farthest
+	* depth of every tile to reject the occluded tiles of a triangle at once
+	*/
+	struct DepthBuffer
+	{
+		static constexpr int TILE_SIZE = 8;
+
+		DepthBuffer(const vi2d& size);
+
+		vi2d size;
+		vi2d tiles;
+
+		std::vector<float> depth;
+		std::vector<float> tileMax;
+
+		void Clear(float value = 1.0f);
+
+		// Returns true if the depth is closer than the stored one
+		bool Test(int x, int y, float z) const;
+
+		// Must be called only for the pixels that were drawn
+		void Write(int x, int y, float z);
+
+		// Recomputes the farthest depth of the tiles that were written to
+		void UpdateTiles();
+
+	private:
+		std::vector<bool> m_DirtyTiles;
+		std::vector<int> m_DirtyList;
+
 	};
 
 	struct Graphic
@@ -532,6 +720,9 @@ namespace def
 
 		Texture* texture = nullptr;
 		Sprite* sprite = nullptr;
+		DepthBuffer* depth = nullptr;
+
+		void EnableDepth(bool enable);
 
 		void Load(std::string_view fileName);
 		void Load(const vi2d& size);
@@ -540,6 +731,13 @@ namespace def
 		void UpdateTexture();
 	};
 
+	enum class CullMode
+	{
+		NONE,
+		BACK,
+		FRONT
+	};
+
 	enum class WindowState
 	{
 		NONE,
@@ -561,10 +759,254 @@ namespace def
 		std::vector<vf2d> uv;
 
 		bool drawBeforeTransforms;
+
+		// 1-based index of the frame's view transform that the platform applies to the vertices,
+		// 0 if they are in screen space
+		uint32_t view;
+	};
+
+	/*
+	* Every worker owns a queue, tasks are popped from its back
+	* and idle workers steal from the front of the other queues.
+	* Threads that wait for tasks (Wait, WaitAll, ParallelFor) execute
+	* pending tasks instead of blocking
+	*/
+	class ThreadPool
+	{
+	public:
+		struct Task
+		{
+			std::function<void()> func;
+
+			std::atomic<int> dependencies;
+			std::atomic<bool> isDone;
+
+			std::mutex mutex;
+			std::vector<std::shared_ptr<Task>> continuations;
+		};
+
+		using TaskHandle = std::shared_ptr<Task>;
+
+		// If threads is 0 then a worker per hardware thread except the calling one is created
+		ThreadPool(size_t threads = 0);
+		~ThreadPool();
+
+		// The task starts only after all of its dependencies are done
+		TaskHandle Schedule(const std::function<void()>& func, const std::vector<TaskHandle>& dependencies = {});
+
+		void Wait(const TaskHandle& task);
+
+		// Must not be called from a task since it waits for the task itself
+		void WaitAll();
+
+		// Calls func(i) for i in [begin, end) splitting the range into chunks of grain size,
+		// if grain is 0 then it's picked by the number of workers
+		template <class F>
+		void ParallelFor(int begin, int end, int grain, F&& func);
+
+		size_t GetWorkerCount() const;
+
+	private:
+		struct Queue
+		{
+			std::mutex mutex;
+			std::deque<TaskHandle> tasks;
+		};
+
+		void Push(const TaskHandle& task);
+		TaskHandle Pop();
+
+		bool RunPending();
+		void Run(const TaskHandle& task);
+
+		void WorkerLoop(size_t index);
+
+	private:
+		std::vector<std::thread> m_Workers;
+
+		// The last queue is shared by all of the threads that aren't workers
+		std::vector<std::unique_ptr<Queue>> m_Queues;
+
+		std::atomic<int> m_QueuedCount;
+		std::atomic<int> m_UnfinishedCount;
+
+		std::mutex m_SleepMutex;
+		std::condition_variable m_WakeUp;
+		bool m_Stop;
+
+		inline static thread_local ThreadPool* s_CurrentPool = nullptr;
+		inline static thread_local size_t s_CurrentQueue = 0;
+
+	};
+
+	/*
+	* Uniform grid broadphase for axis aligned bounds. Objects are referenced by
+	* the id passed to Insert (usually an index into the caller's array).
+	* Rebuild sorts the covered cells with a counting sort into a flat array,
+	* the cells are hashed into a power of two table so the world is unbounded.
+	* Queries and FindPairs report every object or pair once and are thread safe
+	*/
+	class SpatialHash
+	{
+	public:
+		SpatialHash(float cellSize = 32.0f);
+
+		void SetCellSize(float cellSize);
+		float GetCellSize() const;
+
+		void Clear();
+
+		// The bounds are given by the top left corner and the size
+		void Insert(uint32_t id, const vf2d& pos, const vf2d& size);
+		void Move(uint32_t id, const vf2d& pos, const vf2d& size);
+		void Remove(uint32_t id);
+
+		bool Contains(uint32_t id) const;
+		size_t GetCount() const;
+
+		// Must be called after the objects were changed and before the queries
+		void Rebuild();
+
+		void QueryRect(const vf2d& pos, const vf2d& size, std::vector<uint32_t>& ids) const;
+		void QueryCircle(const vf2d& centre, float radius, std::vector<uint32_t>& ids) const;
+
+		// Pairs of objects with overlapping bounds, the first id is the smaller one
+		void FindPairs(std::vector<std::pair<uint32_t, uint32_t>>& pairs) const;
+
+	private:
+		struct Entry
+		{
+			vf2d min;
+			vf2d max;
+
+			vi2d cell;
+			uint32_t id;
+		};
+
+		vi2d GetCell(const vf2d& pos) const;
+		uint32_t GetBucket(const vi2d& cell) const;
+
+		// Calls func(entry) once for every object that overlaps the bounds
+		template <class F>
+		void Query(const vf2d& min, const vf2d& max, F&& func) const;
+
+	private:
+		float m_CellSize;
+		float m_InvCellSize;
+
+		std::vector<vf2d> m_Min;
+		std::vector<vf2d> m_Max;
+		std::vector<bool> m_IsAlive;
+		size_t m_Count;
+
+		std::vector<vi2d> m_FirstCell;
+		std::vector<vi2d> m_LastCell;
+
+		// Entries of the bucket i are in [m_BucketStart[i], m_BucketStart[i + 1])
+		std::vector<Entry> m_Entries;
+		std::vector<uint32_t> m_BucketStart;
+		uint32_t m_BucketMask;
+
 	};
 
 	class GameEngine;
 
+	/*
+	* Particles are stored as a structure of arrays and integrated by plain loops
+	* over contiguous floats so the compiler can vectorize them. Dead particles are
+	* replaced by the last one so the arrays stay dense
+	*/
+	class ParticleSystem
+	{
+	public:
+		struct Emitter
+		{
+			// Particles spawn uniformly in [pos, pos + size]
+			vf2d pos;
+			vf2d size;
+
+			// Particles per second
+			float rate = 0.0f;
+
+			// The velocity points at angle +- spread / 2
+			float angle = 0.0f;
+			float spread = 6.2831853f;
+
+			float minSpeed = 0.0f;
+			float maxSpeed = 0.0f;
+
+			float minLife = 1.0f;
+			float maxLife = 1.0f;
+
+			Pixel colour = WHITE;
+			bool isActive = true;
+
+			float accumulator = 0.0f;
+		};
+
+		// If capacity is 0 then the number of particles isn't limited
+		ParticleSystem(size_t capacity = 0);
+
+		void SetGravity(const vf2d& gravity);
+		vf2d GetGravity() const;
+
+		// Fraction of the velocity that is lost per second
+		void SetDrag(float drag);
+		float GetDrag() const;
+
+		// Fades the alpha by the remaining life, it's visible with Pixel::Mode::ALPHA
+		void SetFade(bool enable);
+
+		// Returns false if the capacity is reached
+		bool Emit(const vf2d& pos, const vf2d& vel, float life, const Pixel& col);
+
+		size_t AddEmitter(const Emitter& emitter);
+		Emitter& GetEmitter(size_t index);
+		void ClearEmitters();
+
+		// Chunks of particles are integrated on the pool if it's passed
+		void Update(float deltaTime, ThreadPool* pool = nullptr);
+		void Clear();
+
+		// Splats every particle as a square of size pixels on the draw target
+		void Draw(GameEngine* engine, int size = 1);
+
+		// Submits every particle as a quad of one texture instance,
+		// the texture is stretched over the quad or it's untextured if nullptr
+		void DrawTextures(GameEngine* engine, float size = 1.0f, const Texture* tex = nullptr);
+
+		size_t GetCount() const;
+		size_t GetCapacity() const;
+
+		vf2d GetPosition(size_t i) const;
+		vf2d GetVelocity(size_t i) const;
+
+	private:
+		void Integrate(size_t begin, size_t end, float deltaTime);
+		void RemoveDead();
+
+		Pixel GetColour(size_t i) const;
+		float Random(float min, float max);
+
+		static bool IsRectVisible(float left, float top, int size, const vi2d& screenSize);
+
+	private:
+		std::vector<float> m_PosX, m_PosY;
+		std::vector<float> m_VelX, m_VelY;
+		std::vector<float> m_Age, m_Life;
+		std::vector<Pixel> m_Colours;
+
+		size_t m_Capacity;
+
+		vf2d m_Gravity;
+		float m_Drag;
+		bool m_Fade;
+
+		std::vector<Emitter> m_Emitters;
+		uint32_t m_Seed;
+
+	};
+
 	class Platform
 	{
 	public:
@@ -585,14 +1027,24 @@ namespace def
 		virtual void FlushScreen(bool vsync) const = 0;
 		virtual void PollEvents() const = 0;
 
+		// Changes the swap interval of the context, must be called on the thread that owns it
+		virtual void SetVSync(bool enable) const = 0;
+
 		virtual void DrawQuad(const Pixel& tint) const = 0;
 		virtual void DrawTexture(const TextureInstance& texInst) const = 0;
 
+		// Applied to the vertices of the next DrawTexture calls, maps NDC to NDC
+		virtual void SetViewTransform(const mat3& transform) = 0;
+
 		virtual void BindTexture(int id) const = 0;
 
 		virtual bool ConstructWindow(vi2d& screenSize, const vi2d pixelSize, vi2d& windowSize, bool vsync, bool fullscreen, bool dirtypixel) = 0;
 		
 		virtual void SetIcon(Sprite& icon) const = 0;
+
+		// Makes the rendering context current on the calling thread or detaches it
+		virtual void AcquireContext() const = 0;
+		virtual void ReleaseContext() const = 0;
 	};
 
 #ifdef PLATFORM_GL
@@ -608,6 +1060,8 @@ namespace def
 		void DrawQuad(const Pixel& tint) const override;
 		void DrawTexture(const TextureInstance& texInst) const override;
 
+		void SetViewTransform(const mat3& transform) override;
+
 		void BindTexture(int id) const override;
 
 		void Destroy() const override;
@@ -622,9 +1076,14 @@ namespace def
 		void FlushScreen(bool vsync) const override;
 		void PollEvents() const override;
 
+		void SetVSync(bool enable) const override;
+
 		bool ConstructWindow(vi2d& screenSize, const vi2d pixelSize, vi2d& windowSize, bool vsync, bool fullscreen, bool dirtypixel) override;
 
 		void SetIcon(Sprite& icon) const override;
+
+		void AcquireContext() const override;
+		void ReleaseContext() const override;
 	};
 
 #endif
@@ -646,10 +1105,15 @@ namespace def
 		void FlushScreen(bool vsync) const override;
 		void PollEvents() const override;
 
+		void SetVSync(bool enable) const override;
+
 		bool ConstructWindow(vi2d& screenSize, const vi2d pixelSize, vi2d& windowSize, bool vsync, bool fullscreen, bool dirtypixel) override;
 
 		void SetIcon(Sprite& icon) const override;
 
+		void AcquireContext() const override;
+		void ReleaseContext() const override;
+
 	private:
 		static LRESULT CALLBACK WindowEvent(HWND window, UINT message, WPARAM param1, LPARAM param2);
 
@@ -732,9 +1196,100 @@ namespace def
 		void FlushScreen(bool vsync) const override;
 		void PollEvents() const override;
 
+		void SetVSync(bool enable) const override;
+
 		bool ConstructWindow(vi2d& screenSize, const vi2d pixelSize, vi2d& windowSize, bool vsync, bool fullscreen, bool dirtypixel) override;
 		
 		void SetIcon(Sprite& icon) const override;
+
+		void AcquireContext() const override;
+		void ReleaseContext() const override;
+	};
+
+#endif
+
+#ifdef PLATFORM_HEADLESS
+
+	/*
+	* Renders everything into a sprite without creating a window,
+	* so the engine can run on machines without a display.
+	* Input is not polled from anywhere and must be set manually
+	*/
+	class Platform_Headless : public Platform
+	{
+	public:
+		Platform_Headless();
+
+		void Destroy() const override;
+		void SetTitle(const std::string& text) const override;
+
+		bool IsWindowClose() const override;
+		bool IsWindowFocused() const override;
+
+		bool GetKey(int key) const override;
+		bool GetMouse(int button) const override;
+
+		void ClearBuffer(const Pixel& col) const override;
+
+		void OnBeforeDraw() override;
+		void OnAfterDraw() override;
+
+		void FlushScreen(bool vsync) const override;
+		void PollEvents() const override;
+
+		void SetVSync(bool enable) const override;
+
+		void DrawQuad(const Pixel& tint) const override;
+		void DrawTexture(const TextureInstance& texInst) const override;
+
+		void SetViewTransform(const mat3& transform) override;
+
+		void BindTexture(int id) const override;
+
+		bool ConstructWindow(vi2d& screenSize, const vi2d pixelSize, vi2d& windowSize, bool vsync, bool fullscreen, bool dirtypixel) override;
+
+		void SetIcon(Sprite& icon) const override;
+
+		void AcquireContext() const override;
+		void ReleaseContext() const override;
+
+		void SetKey(int key, bool held);
+		void SetMouse(int button, bool held);
+
+		void SetMousePos(const vi2d& pos);
+		void SetScrollDelta(int delta);
+
+		void Close();
+
+		const Sprite& GetFramebuffer() const;
+
+	private:
+		vf2d ToScreen(const vf2d& vertex) const;
+		Pixel SampleTexture(const vf2d& uv, const Pixel& tint) const;
+		void BlendPixel(int x, int y, const Pixel& col) const;
+
+		void RasterizeTriangle(const vf2d* vertices, const vf2d* uv, const Pixel* tint) const;
+		void RasterizeLine(const vf2d* vertices, const vf2d* uv, const Pixel* tint) const;
+
+	private:
+		mutable Sprite m_Framebuffer;
+		mutable int m_BoundTexture;
+
+		mat3 m_ViewTransform;
+		bool m_HasViewTransform;
+
+		bool m_Keys[512];
+		bool m_Mouse[8];
+
+		bool m_IsClosed;
+
+	public:
+		// Textures are kept on the CPU, the texture id is an index into the list plus one
+		inline static std::vector<Sprite> s_Textures;
+
+		// Ids of the deleted textures whose slots can be reused
+		inline static std::vector<uint32_t> s_FreeTextures;
+
 	};
 
 #endif
@@ -753,6 +1308,13 @@ namespace def
 		friend class Platform_GLFW3;
 #endif
 
+#ifdef PLATFORM_HEADLESS
+		friend class Platform_Headless;
+#endif
+
+		friend struct Texture;
+		friend class ParticleSystem;
+
 	private:
 		std::string m_AppName;
 
@@ -765,8 +1327,20 @@ namespace def
 		bool m_IsFullScreen;
 		bool m_IsDirtyPixel;
 		bool m_IsVSync;
+
+		// The swap interval that is set on the context, only used by the thread that renders
+		bool m_IsContextVSync;
+
 		bool m_OnlyTextures;
 		bool m_DrawBeforeTransforms;
+		bool m_UseViewTransform;
+
+		// Maps world space to screen space for the texture calls made with m_UseViewTransform
+		mat3 m_ViewTransform;
+
+		// The views of the current frame in NDC and the index of m_ViewTransform among them (0 if it wasn't added yet)
+		std::vector<mat3> m_Views;
+		uint32_t m_ViewIndex;
 
 		KeyState m_Keys[512];
 		KeyState m_Mouse[8];
@@ -819,12 +1393,84 @@ namespace def
 
 		Pixel (*m_Shader)(const vi2d&, const Pixel&, const Pixel&);
 
+		// Counter-clockwise triangles in NDC are front facing
+		CullMode m_CullMode;
+
+		// Back buffer for the ApplyShader passes that read neighbours
+		Sprite m_ShaderBuffer;
+
 		Platform* m_Platform;
 
+		struct InputFrame
+		{
+			float deltaTime;
+
+			vi2d mousePos;
+			int scrollDelta;
+
+			bool keys[512];
+			bool mouse[8];
+		};
+
+		std::ofstream m_RecordFile;
+		std::ifstream m_ReplayFile;
+
+		InputFrame m_RecordedFrame;
+		InputFrame m_ReplayedFrame;
+
+		float m_ReplayDeltaTime;
+		bool m_CloseOnReplayEnd;
+
+		struct FrameData
+		{
+			// GL work (texture uploads) that must run before drawing the frame
+			std::vector<std::function<void()>> commands;
+			std::vector<TextureInstance> textures;
+
+			const Texture* screen = nullptr;
+			Pixel clearColour;
+			bool vsync = false;
+
+			// View transforms in NDC that the world space textures refer to
+			std::vector<mat3> views;
+		};
+
+		std::vector<std::function<void()>> m_RenderCommands;
+		FrameData m_PendingFrame;
+
+		bool m_IsPipelined;
+
+		std::thread m_RenderThread;
+		std::mutex m_RenderMutex;
+		std::condition_variable m_RenderCondition;
+
+		bool m_HasPendingFrame;
+		bool m_IsRendering;
+		bool m_StopRendering;
+		bool m_AfterDrawResult;
+
+		std::unique_ptr<ThreadPool> m_ThreadPool;
+
+		FrameStats m_FrameStats;
+		float m_FrameCap;
+
+		// Written by the thread that draws the frame
+		float m_RenderTime;
+		uint32_t m_DrawCalls;
+		uint32_t m_TextureInstances;
+
+		// Textures can be uploaded from the render thread and pixels can be drawn from the thread pool
+		std::atomic<uint64_t> m_TextureMemory;
+		std::atomic<uint64_t> m_UploadBytes;
+		std::atomic<uint64_t> m_PixelsWritten;
+
 	public:
 		static GameEngine* s_Engine;
 		static std::unordered_map<Key, std::pair<char, char>> s_KeyboardUS;
-		inline static std::vector<vf2d> s_UnitCircle;
+
+		// Unit circles with 8, 16, ..., 256 segments, the first point is repeated at the end
+		inline static constexpr size_t UNIT_CIRCLE_LODS = 6;
+		inline static std::vector<vf2d> s_UnitCircles[UNIT_CIRCLE_LODS];
 
 		virtual bool OnUserCreate() = 0;
 		virtual bool OnUserUpdate(float deltaTime) = 0;
@@ -841,9 +1487,36 @@ namespace def
 		void ScanHardware(KeyState* data, bool* newState, bool* oldState, size_t count, std::function<bool(Platform*, int)> Get);
 		void MainLoop();
 
-		static void MakeUnitCircle(std::vector<vf2d>& circle, const size_t verts);
+		void WriteInputFrame();
+		bool ReadInputFrame();
 
-	public:
+		void SubmitFrame();
+		bool DrawFrame(FrameData& frame);
+		void CollectRenderStats();
+		void RenderThread();
+		bool NeedsDeferredRendering() const;
+
+		// The index for TextureInstance::view of the next texture call
+		uint32_t GetViewIndex();
+
+		// Blocks until the render thread has drawn the submitted frame
+		void WaitForRenderThread();
+
+		static void MakeUnitCircle(std::vector<vf2d>& circle, const size_t verts);
+
+		// The vertices of the triangles passed to RasterizeClipped stay within [-GUARD_BAND, GUARD_BAND]
+		// so the products of the 24.8 fixed point coordinates fit into 64 bits
+		static constexpr float GUARD_BAND = float(1 << 20);
+
+		// weights[k] are the barycentric weights of the vertex k in the triangle it was clipped from or nullptr if it wasn't
+		template <class Fragment, class TileTest>
+		void RasterizeClipped(const vf2d* pos, const float (*weights)[3], const float* invW, Fragment& fragment, TileTest& acceptTile) const;
+
+		// Picks the LOD by the radius in window pixels
+		const std::vector<vf2d>& GetUnitCircle(int radius) const;
+		void PushTextureCircle(const vi2d& pos, int radius, const Pixel& col, Texture::Structure structure);
+
+	public:
 		bool Draw(const vi2d& pos, const Pixel& col = WHITE);
 		virtual bool Draw(int x, int y, const Pixel& col = WHITE);
 
@@ -856,6 +1529,28 @@ namespace def
 		void FillTriangle(const vi2d& pos1, const vi2d& pos2, const vi2d& pos3, const Pixel& col = WHITE);
 		virtual void FillTriangle(int x1, int y1, int x2, int y2, int x3, int y3, const Pixel& col = WHITE);
 
+		// Calls fragment(x, y, linear, perspective) for every pixel of the draw target that is covered by the triangle,
+		// linear and perspective are 3 barycentric weights (the latter is corrected by the w of every vertex)
+		template <class Fragment>
+		void RasterizeTriangle(const vf2d& pos1, const vf2d& pos2, const vf2d& pos3, float w1, float w2, float w3, Fragment&& fragment) const;
+
+		// The same but the pixels of a DepthBuffer::TILE_SIZE tile are skipped if acceptTile(tileX, tileY) returns false
+		template <class Fragment, class TileTest>
+		void RasterizeTriangle(const vf2d& pos1, const vf2d& pos2, const vf2d& pos3, float w1, float w2, float w3, Fragment&& fragment, TileTest&& acceptTile) const;
+
+		// UVs are normalized, w is used for the perspective-correct interpolation
+		void DrawTexturedTriangle(const vf2d& pos1, const vf2d& pos2, const vf2d& pos3, const vf2d& uv1, const vf2d& uv2, const vf2d& uv3, const Sprite* sprite, const Pixel& tint = WHITE, float w1 = 1.0f, float w2 = 1.0f, float w3 = 1.0f);
+
+		// The positions are transformed into clip space, clipped by the near plane, culled and
+		// depth tested against the depth buffer of the draw target (if it has one), a nullptr sprite draws the tint
+		void DrawTriangle3D(const mat4& transform, const vf4d& pos1, const vf4d& pos2, const vf4d& pos3, const vf2d& uv1, const vf2d& uv2, const vf2d& uv3, const Sprite* sprite, const Pixel& tint = WHITE);
+		void DrawMesh(const mat4& transform, const std::vector<vf4d>& positions, const std::vector<vf2d>& uvs, const std::vector<uint32_t>& indices, const Sprite* sprite, const Pixel& tint = WHITE);
+
+		void ClearDepth(float value = 1.0f);
+
+		void SetCullMode(CullMode mode);
+		CullMode GetCullMode() const;
+
 		void DrawRectangle(const vi2d& pos, const vi2d& size, const Pixel& col = WHITE);
 		virtual void DrawRectangle(int x, int y, int sizeX, int sizeY, const Pixel& col = WHITE);
 
@@ -886,6 +1581,9 @@ namespace def
 		void FillWireFrameModel(const std::vector<vf2d>& modelCoordinates, const vf2d& pos, float rotation = 0.0f, float scale = 1.0f, const Pixel& col = WHITE);
 		virtual void FillWireFrameModel(const std::vector<vf2d>& modelCoordinates, float x, float y, float rotation = 0.0f, float scale = 1.0f, const Pixel& col = WHITE);
 
+		void DrawWireFrameModel(const std::vector<vf2d>& modelCoordinates, const mat3& transform, const Pixel& col = WHITE);
+		void FillWireFrameModel(const std::vector<vf2d>& modelCoordinates, const mat3& transform, const Pixel& col = WHITE);
+
 		void DrawString(const vi2d& pos, std::string_view text, const Pixel& col = WHITE, const vi2d& scale = { 1, 1 });
 		virtual void DrawString(int x, int y, std::string_view text, const Pixel& col = WHITE, int scaleX = 1, int scaleY = 1);
 
@@ -899,7 +1597,11 @@ namespace def
 
 		void DrawRotatedTexture(const vf2d& pos, const Texture* tex, float rotation, const vf2d& center = { 0.0f, 0.0f }, const vf2d& scale = { 1.0f, 1.0f }, const Pixel& tint = WHITE);
 		void DrawPartialRotatedTexture(const vf2d& pos, const Texture* tex, const vf2d& filePos, const vf2d& fileSize, float rotation, const vf2d& center = { 0.0f, 0.0f }, const vf2d& scale = { 1.0f, 1.0f }, const Pixel& tint = WHITE);
-		
+
+		// The transform maps the texture (or the part of it) from [0, size] to the screen
+		void DrawTexture(const mat3& transform, const Texture* tex, const Pixel& tint = WHITE);
+		void DrawPartialTexture(const mat3& transform, const Texture* tex, const vf2d& filePos, const vf2d& fileSize, const Pixel& tint = WHITE);
+
 		void DrawTexturePolygon(const std::vector<vf2d>& verts, const std::vector<Pixel>& cols, Texture::Structure structure);
 
 		void DrawTextureLine(const vi2d& pos1, const vi2d& pos2, const Pixel& col = WHITE);
@@ -938,6 +1640,18 @@ namespace def
 		bool IsVSync() const;
 		bool IsFocused() const;
 
+		void SetVSync(bool enable);
+
+		// Limits the frame rate by sleeping at the end of the frame, 0 disables it
+		void SetFrameCap(float fps);
+		float GetFrameCap() const;
+
+		// Should be read from OnUserUpdate
+		const FrameStats& GetFrameStats() const;
+
+		// Used by the code that writes to the draw target without going through Draw
+		void AddPixelsWritten(uint64_t count);
+
 		void SetIcon(std::string_view fileName);
 
 		void SetDrawTarget(Graphic* target);
@@ -953,6 +1667,12 @@ namespace def
 
 		void SetShader(Pixel (*func)(const vi2d&, const Pixel&, const Pixel&));
 
+		// Calls shader(pos, source) -> Pixel for every pixel of the target (the draw target if nullptr)
+		// in blocks of rows on the thread pool, if readsNeighbours is true then the results are
+		// written into a back buffer that is swapped with the target after the pass
+		template <class Shader>
+		void ApplyShader(Graphic* target, Shader&& shader, bool readsNeighbours = true);
+
 		void CaptureText(bool enable);
 		bool IsCapturingText() const;
 
@@ -969,7 +1689,45 @@ namespace def
 
 		void UseOnlyTextures(bool enable);
 
+		/*
+		* While enabled the texture calls take world space coordinates and the view transform
+		* is applied by the platform when the frame is drawn, so moving the view doesn't
+		* touch the vertices. Every texture call uses the transform that was set when it was made
+		*/
+		void UseViewTransform(bool enable);
+		bool IsViewTransformUsed() const;
+
+		void SetViewTransform(const mat3& transform);
+		const mat3& GetViewTransform() const;
+
+		/*
+		* Must be set before Run(). Frames are drawn by a separate thread that owns
+		* the rendering context while the next OnUserUpdate is running.
+		* In this mode OnAfterDraw is called from the render thread and textures
+		* used in the previous frame must not be deleted until the next frame is submitted
+		*/
+		void UsePipelinedRendering(bool enable);
+		bool IsPipelinedRendering() const;
+
 		float GetDeltaTime() const;
+
+		bool StartRecording(std::string_view fileName);
+		void StopRecording();
+		bool IsRecording() const;
+
+		// If fixedDeltaTime is 0 then the recorded frame times are used
+		bool StartReplay(std::string_view fileName, float fixedDeltaTime = 0.0f, bool closeOnEnd = true);
+		void StopReplay();
+		bool IsReplaying() const;
+
+		Platform* GetPlatform();
+
+		// The pool is created on the first call
+		ThreadPool& GetThreadPool();
+
+		template <class F>
+		void ParallelFor(int begin, int end, int grain, F&& func);
+		void WaitAll();
 	};
 
 #ifdef DGE_APPLICATION
@@ -1378,8 +2136,422 @@ namespace def
 		return "(" + std::to_string(x) + ", " + std::to_string(y) + ")";
 	}
 
+	vf2dArray::vf2dArray(size_t size)
+	{
+		resize(size);
+	}
+
+	vf2dArray::vf2dArray(const std::vector<vf2d>& points)
+	{
+		assign(points);
+	}
+
+	size_t vf2dArray::size() const
+	{
+		return x.size();
+	}
+
+	void vf2dArray::resize(size_t size)
+	{
+		x.resize(size);
+		y.resize(size);
+	}
+
+	void vf2dArray::reserve(size_t size)
+	{
+		x.reserve(size);
+		y.reserve(size);
+	}
+
+	void vf2dArray::clear()
+	{
+		x.clear();
+		y.clear();
+	}
+
+	void vf2dArray::push_back(const vf2d& v)
+	{
+		x.push_back(v.x);
+		y.push_back(v.y);
+	}
+
+	vf2d vf2dArray::get(size_t i) const
+	{
+		return { x[i], y[i] };
+	}
+
+	void vf2dArray::set(size_t i, const vf2d& v)
+	{
+		x[i] = v.x;
+		y[i] = v.y;
+	}
+
+	void vf2dArray::assign(const std::vector<vf2d>& points)
+	{
+		resize(points.size());
+
+		float* __restrict px = x.data();
+		float* __restrict py = y.data();
+
+		for (size_t i = 0; i < points.size(); i++)
+		{
+			px[i] = points[i].x;
+			py[i] = points[i].y;
+		}
+	}
+
+	void vf2dArray::store(std::vector<vf2d>& points) const
+	{
+		points.resize(size());
+
+		const float* __restrict px = x.data();
+		const float* __restrict py = y.data();
+
+		for (size_t i = 0; i < points.size(); i++)
+		{
+			points[i].x = px[i];
+			points[i].y = py[i];
+		}
+	}
+
+	std::vector<vf2d> vf2dArray::vector() const
+	{
+		std::vector<vf2d> points;
+		store(points);
+		return points;
+	}
+
+	void vf2dArray::translate(const vf2d& offset)
+	{
+		float* __restrict px = x.data();
+		float* __restrict py = y.data();
+
+		for (size_t i = 0; i < x.size(); i++)
+		{
+			px[i] += offset.x;
+			py[i] += offset.y;
+		}
+	}
+
+	void vf2dArray::scale(const vf2d& factor)
+	{
+		float* __restrict px = x.data();
+		float* __restrict py = y.data();
+
+		for (size_t i = 0; i < x.size(); i++)
+		{
+			px[i] *= factor.x;
+			py[i] *= factor.y;
+		}
+	}
+
+	void vf2dArray::rotate(float angle)
+	{
+		transform(angle, 1.0f, { 0.0f, 0.0f });
+	}
+
+	void vf2dArray::transform(float angle, float scale, const vf2d& offset)
+	{
+		float* __restrict px = x.data();
+		float* __restrict py = y.data();
+
+		const float cs = cosf(angle) * scale;
+		const float sn = sinf(angle) * scale;
+
+		for (size_t i = 0; i < x.size(); i++)
+		{
+			float ox = px[i], oy = py[i];
+
+			px[i] = ox * cs - oy * sn + offset.x;
+			py[i] = ox * sn + oy * cs + offset.y;
+		}
+	}
+
+	void vf2dArray::norm()
+	{
+		float* __restrict px = x.data();
+		float* __restrict py = y.data();
+
+		for (size_t i = 0; i < x.size(); i++)
+		{
+			float len2 = px[i] * px[i] + py[i] * py[i];
+			float inv = len2 > 0.0f ? 1.0f / sqrtf(len2) : 0.0f;
+
+			px[i] *= inv;
+			py[i] *= inv;
+		}
+	}
+
+	void vf2dArray::lerp(const vf2dArray& target, float t)
+	{
+		float* __restrict px = x.data();
+		float* __restrict py = y.data();
+
+		const float* __restrict tx = target.x.data();
+		const float* __restrict ty = target.y.data();
+
+		size_t count = std::min(size(), target.size());
+
+		for (size_t i = 0; i < count; i++)
+		{
+			px[i] += (tx[i] - px[i]) * t;
+			py[i] += (ty[i] - py[i]) * t;
+		}
+	}
+
+	void vf2dArray::dot(const vf2dArray& other, std::vector<float>& out) const
+	{
+		size_t count = std::min(size(), other.size());
+		out.resize(count);
+
+		const float* __restrict px = x.data();
+		const float* __restrict py = y.data();
+
+		const float* __restrict ox = other.x.data();
+		const float* __restrict oy = other.y.data();
+
+		float* __restrict res = out.data();
+
+		for (size_t i = 0; i < count; i++)
+			res[i] = px[i] * ox[i] + py[i] * oy[i];
+	}
+
+	void vf2dArray::length(std::vector<float>& out) const
+	{
+		out.resize(size());
+
+		const float* __restrict px = x.data();
+		const float* __restrict py = y.data();
+
+		float* __restrict res = out.data();
+
+		for (size_t i = 0; i < out.size(); i++)
+			res[i] = sqrtf(px[i] * px[i] + py[i] * py[i]);
+	}
+
+#endif
+
+	mat3::mat3() : m{ { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } }
+	{
+	}
+
+	mat3::mat3(float m00, float m01, float m02, float m10, float m11, float m12)
+		: m{ { m00, m01, m02 }, { m10, m11, m12 }, { 0.0f, 0.0f, 1.0f } }
+	{
+	}
+
+	mat3 mat3::translate(const vf2d& offset)
+	{
+		return mat3(1.0f, 0.0f, offset.x, 0.0f, 1.0f, offset.y);
+	}
+
+	mat3 mat3::rotate(float angle)
+	{
+		float c = cosf(angle), s = sinf(angle);
+		return mat3(c, -s, 0.0f, s, c, 0.0f);
+	}
+
+	mat3 mat3::scale(const vf2d& factor)
+	{
+		return mat3(factor.x, 0.0f, 0.0f, 0.0f, factor.y, 0.0f);
+	}
+
+	mat3 mat3::operator*(const mat3& rhs) const
+	{
+		mat3 res;
+
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 3; j++)
+				res.m[i][j] = m[i][0] * rhs.m[0][j] + m[i][1] * rhs.m[1][j] + m[i][2] * rhs.m[2][j];
+
+		return res;
+	}
+
+	mat3& mat3::operator*=(const mat3& rhs)
+	{
+		*this = *this * rhs;
+		return *this;
+	}
+
+	vf2d mat3::operator*(const vf2d& point) const
+	{
+		return transform(point);
+	}
+
+	vf2d mat3::transform(const vf2d& point) const
+	{
+		return
+		{
+			m[0][0] * point.x + m[0][1] * point.y + m[0][2],
+			m[1][0] * point.x + m[1][1] * point.y + m[1][2]
+		};
+	}
+
+	void mat3::transform(const vf2d* in, vf2d* out, size_t count) const
+	{
+		const float a = m[0][0], b = m[0][1], c = m[0][2];
+		const float d = m[1][0], e = m[1][1], f = m[1][2];
+
+		for (size_t i = 0; i < count; i++)
+		{
+			float x = in[i].x, y = in[i].y;
+
+			out[i].x = a * x + b * y + c;
+			out[i].y = d * x + e * y + f;
+		}
+	}
+
+	void mat3::transform(std::vector<vf2d>& points) const
+	{
+		transform(points.data(), points.data(), points.size());
+	}
+
+#ifndef DGE_IGNORE_VEC2D
+
+	void mat3::transform(vf2dArray& points) const
+	{
+		const float a = m[0][0], b = m[0][1], c = m[0][2];
+		const float d = m[1][0], e = m[1][1], f = m[1][2];
+
+		float* __restrict px = points.x.data();
+		float* __restrict py = points.y.data();
+
+		for (size_t i = 0; i < points.size(); i++)
+		{
+			float x = px[i], y = py[i];
+
+			px[i] = a * x + b * y + c;
+			py[i] = d * x + e * y + f;
+		}
+	}
+
 #endif
 
+	float mat3::det() const
+	{
+		return m[0][0] * m[1][1] - m[0][1] * m[1][0];
+	}
+
+	mat4::mat4() : m{ { 1.0f, 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f } }
+	{
+	}
+
+	mat4 mat4::translate(float x, float y, float z)
+	{
+		mat4 res;
+		res.m[0][3] = x;
+		res.m[1][3] = y;
+		res.m[2][3] = z;
+		return res;
+	}
+
+	mat4 mat4::scale(float x, float y, float z)
+	{
+		mat4 res;
+		res.m[0][0] = x;
+		res.m[1][1] = y;
+		res.m[2][2] = z;
+		return res;
+	}
+
+	mat4 mat4::rotateX(float angle)
+	{
+		float c = cosf(angle), s = sinf(angle);
+
+		mat4 res;
+		res.m[1][1] = c; res.m[1][2] = -s;
+		res.m[2][1] = s; res.m[2][2] = c;
+		return res;
+	}
+
+	mat4 mat4::rotateY(float angle)
+	{
+		float c = cosf(angle), s = sinf(angle);
+
+		mat4 res;
+		res.m[0][0] = c; res.m[0][2] = s;
+		res.m[2][0] = -s; res.m[2][2] = c;
+		return res;
+	}
+
+	mat4 mat4::rotateZ(float angle)
+	{
+		float c = cosf(angle), s = sinf(angle);
+
+		mat4 res;
+		res.m[0][0] = c; res.m[0][1] = -s;
+		res.m[1][0] = s; res.m[1][1] = c;
+		return res;
+	}
+
+	mat4 mat4::perspective(float fovY, float aspect, float nearPlane, float farPlane)
+	{
+		float f = 1.0f / tanf(fovY * 0.5f);
+
+		mat4 res;
+		res.m[0][0] = f / aspect;
+		res.m[1][1] = f;
+		res.m[2][2] = (farPlane + nearPlane) / (nearPlane - farPlane);
+		res.m[2][3] = 2.0f * farPlane * nearPlane / (nearPlane - farPlane);
+		res.m[3][2] = -1.0f;
+		res.m[3][3] = 0.0f;
+		return res;
+	}
+
+	mat4 mat4::operator*(const mat4& rhs) const
+	{
+		mat4 res;
+
+		for (int i = 0; i < 4; i++)
+			for (int j = 0; j < 4; j++)
+				res.m[i][j] = m[i][0] * rhs.m[0][j] + m[i][1] * rhs.m[1][j] + m[i][2] * rhs.m[2][j] + m[i][3] * rhs.m[3][j];
+
+		return res;
+	}
+
+	mat4& mat4::operator*=(const mat4& rhs)
+	{
+		*this = *this * rhs;
+		return *this;
+	}
+
+	vf4d mat4::operator*(const vf4d& v) const
+	{
+		vf4d res;
+		transform(&v, &res, 1);
+		return res;
+	}
+
+	void mat4::transform(const vf4d* in, vf4d* out, size_t count) const
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			float x = in[i].x, y = in[i].y, z = in[i].z, w = in[i].w;
+
+			out[i].x = m[0][0] * x + m[0][1] * y + m[0][2] * z + m[0][3] * w;
+			out[i].y = m[1][0] * x + m[1][1] * y + m[1][2] * z + m[1][3] * w;
+			out[i].z = m[2][0] * x + m[2][1] * y + m[2][2] * z + m[2][3] * w;
+			out[i].w = m[3][0] * x + m[3][1] * y + m[3][2] * z + m[3][3] * w;
+		}
+	}
+
+	mat3 mat3::invert() const
+	{
+		float d = det();
+
+		if (d == 0.0f)
+			return mat3();
+
+		float inv = 1.0f / d;
+
+		float a = m[1][1] * inv, b = -m[0][1] * inv;
+		float c = -m[1][0] * inv, e = m[0][0] * inv;
+
+		return mat3(
+			a, b, -(a * m[0][2] + b * m[1][2]),
+			c, e, -(c * m[0][2] + e * m[1][2]));
+	}
+
 	constexpr KeyState::KeyState() : held(false), released(false), pressed(false)
 	{
 
@@ -1810,8 +2982,40 @@ namespace def
 		Construct(new Sprite(fileName), true);
 	}
 
+	Texture::~Texture()
+	{
+		GameEngine* engine = GameEngine::s_Engine;
+
+		// The submitted frame can still be uploading or drawing the texture
+		// so the render thread must finish it before the texture is gone
+		bool isDeferred = engine && engine->NeedsDeferredRendering();
+
+		if (isDeferred)
+			engine->WaitForRenderThread();
+
+		*m_Self = nullptr;
+
+		// Without the engine the context is gone and so are its textures
+		if (!engine)
+			return;
+
+		SetMemoryUsage(0);
+
+		if (id != 0)
+		{
+			if (isDeferred)
+				engine->m_RenderCommands.push_back([id = id]() { Delete(id); });
+			else
+				Delete(id);
+		}
+	}
+
 	void Texture::Construct(Sprite* sprite, bool deleteSprite)
 	{
+		id = 0;
+		m_Bytes = 0;
+		m_Self = std::make_shared<Texture*>(this);
+
 		Load(sprite);
 
 		uvScale = 1.0f / vf2d(sprite->size);
@@ -1823,6 +3027,26 @@ namespace def
 
 	void Texture::Load(Sprite* sprite)
 	{
+		GameEngine* engine = GameEngine::s_Engine;
+
+		// The render thread owns the context so the upload is postponed
+		if (engine && engine->NeedsDeferredRendering())
+		{
+			Defer(sprite, &Texture::Load);
+			return;
+		}
+
+		uint64_t bytes = uint64_t(sprite->size.x) * uint64_t(sprite->size.y) * sizeof(Pixel);
+
+		if (engine)
+			engine->m_UploadBytes.fetch_add(bytes, std::memory_order_relaxed);
+
+		SetMemoryUsage(bytes);
+
+		// Loading again replaces the previous texture
+		if (id != 0)
+			Delete(id);
+
 #ifdef PLATFORM_GL
 		glGenTextures(1, &id);
 		glBindTexture(GL_TEXTURE_2D, id);
@@ -1845,68 +3069,1027 @@ namespace def
 		);
 
 		glBindTexture(GL_TEXTURE_2D, 0);
-#else
-#error Consider defining PLATFORM_GL macro
-#endif
+#elif defined(PLATFORM_HEADLESS)
+		if (Platform_Headless::s_FreeTextures.empty())
+		{
+			Platform_Headless::s_Textures.push_back(*sprite);
+			id = (uint32_t)Platform_Headless::s_Textures.size();
+		}
+		else
+		{
+			id = Platform_Headless::s_FreeTextures.back();
+			Platform_Headless::s_FreeTextures.pop_back();
+
+			Platform_Headless::s_Textures[id - 1] = *sprite;
+		}
+#else
+#error Consider defining PLATFORM_GL or PLATFORM_HEADLESS macro
+#endif
+	}
+
+	void Texture::Update(Sprite* sprite)
+	{
+		GameEngine* engine = GameEngine::s_Engine;
+
+		if (engine && engine->NeedsDeferredRendering())
+		{
+			Defer(sprite, &Texture::Update);
+			return;
+		}
+
+		uint64_t bytes = uint64_t(sprite->size.x) * uint64_t(sprite->size.y) * sizeof(Pixel);
+
+		if (engine)
+			engine->m_UploadBytes.fetch_add(bytes, std::memory_order_relaxed);
+
+		SetMemoryUsage(bytes);
+
+#ifdef PLATFORM_GL
+		glBindTexture(GL_TEXTURE_2D, id);
+
+		glTexImage2D(
+			GL_TEXTURE_2D,
+			0, GL_RGBA,
+			sprite->size.x,
+			sprite->size.y,
+			0, GL_RGBA,
+			GL_UNSIGNED_BYTE,
+			sprite->pixels.data()
+		);
+
+		glBindTexture(GL_TEXTURE_2D, 0);
+#elif defined(PLATFORM_HEADLESS)
+		Platform_Headless::s_Textures[id - 1] = *sprite;
+#else
+#error Consider defining PLATFORM_GL or PLATFORM_HEADLESS macro
+#endif
+	}
+
+	void Texture::SetMemoryUsage(uint64_t bytes)
+	{
+		GameEngine* engine = GameEngine::s_Engine;
+
+		if (engine)
+		{
+			engine->m_TextureMemory.fetch_add(bytes, std::memory_order_relaxed);
+			engine->m_TextureMemory.fetch_sub(m_Bytes, std::memory_order_relaxed);
+		}
+
+		m_Bytes = bytes;
+	}
+
+	void Texture::Delete(uint32_t id)
+	{
+#ifdef PLATFORM_GL
+		glDeleteTextures(1, &id);
+#elif defined(PLATFORM_HEADLESS)
+		// The list is cleared when the platform is destroyed
+		if (id > Platform_Headless::s_Textures.size())
+			return;
+
+		Platform_Headless::s_Textures[id - 1] = Sprite();
+		Platform_Headless::s_FreeTextures.push_back(id);
+#else
+#error Consider defining PLATFORM_GL or PLATFORM_HEADLESS macro
+#endif
+	}
+
+	void Texture::Defer(Sprite* sprite, void (Texture::*upload)(Sprite*))
+	{
+		// The sprite is copied because it can be modified or deleted by then
+		GameEngine::s_Engine->m_RenderCommands.push_back([self = m_Self, upload, copy = *sprite]() mutable
+			{
+				if (*self)
+					((*self)->*upload)(&copy);
+			});
+	}
+
+	Graphic::Graphic(std::string_view fileName)
+	{
+		Load(fileName);
+	}
+
+	Graphic::Graphic(const vi2d& size)
+	{
+		Load(size);
+	}
+
+	Graphic::~Graphic()
+	{
+		delete texture;
+		delete sprite;
+		delete depth;
+	}
+
+	void Graphic::EnableDepth(bool enable)
+	{
+		delete depth;
+		depth = enable ? new DepthBuffer(sprite->size) : nullptr;
+	}
+
+	DepthBuffer::DepthBuffer(const vi2d& size) : size(size)
+	{
+		tiles = (size + vi2d(TILE_SIZE - 1, TILE_SIZE - 1)) / TILE_SIZE;
+
+		depth.resize(size.x * size.y);
+		tileMax.resize(tiles.x * tiles.y);
+		m_DirtyTiles.resize(tiles.x * tiles.y);
+
+		Clear();
+	}
+
+	void DepthBuffer::Clear(float value)
+	{
+		std::fill(depth.begin(), depth.end(), value);
+		std::fill(tileMax.begin(), tileMax.end(), value);
+		std::fill(m_DirtyTiles.begin(), m_DirtyTiles.end(), false);
+
+		m_DirtyList.clear();
+	}
+
+	bool DepthBuffer::Test(int x, int y, float z) const
+	{
+		return z < depth[y * size.x + x];
+	}
+
+	void DepthBuffer::Write(int x, int y, float z)
+	{
+		depth[y * size.x + x] = z;
+
+		int tile = (y / TILE_SIZE) * tiles.x + x / TILE_SIZE;
+
+		if (!m_DirtyTiles[tile])
+		{
+			m_DirtyTiles[tile] = true;
+			m_DirtyList.push_back(tile);
+		}
+	}
+
+	void DepthBuffer::UpdateTiles()
+	{
+		for (int tile : m_DirtyList)
+		{
+			int startX = (tile % tiles.x) * TILE_SIZE;
+			int startY = (tile / tiles.x) * TILE_SIZE;
+
+			int endX = std::min(startX + TILE_SIZE, size.x);
+			int endY = std::min(startY + TILE_SIZE, size.y);
+
+			float farthest = 0.0f;
+
+			for (int y = startY; y < endY; y++)
+				for (int x = startX; x < endX; x++)
+					farthest = std::max(farthest, depth[y * size.x + x]);
+
+			tileMax[tile] = farthest;
+			m_DirtyTiles[tile] = false;
+		}
+
+		m_DirtyList.clear();
+	}
+
+	void Graphic::Load(std::string_view fileName)
+	{
+		sprite = new Sprite(fileName);
+		texture = new Texture(sprite);
+	}
+
+	void Graphic::Load(const vi2d& size)
+	{
+		sprite = new Sprite(size);
+		texture = new Texture(sprite);
+	}
+
+	void Graphic::Save(std::string_view fileName, const Sprite::FileType type) const
+	{
+		return sprite->Save(fileName, type);
+	}
+
+	void Graphic::UpdateTexture()
+	{
+		texture->Update(sprite);
+	}
+
+	ThreadPool::ThreadPool(size_t threads)
+	{
+		if (threads == 0)
+			threads = std::max(1u, std::thread::hardware_concurrency()) - 1;
+
+		// At least one worker is needed for tasks that nobody waits for
+		threads = std::max(threads, (size_t)1);
+
+		m_QueuedCount = 0;
+		m_UnfinishedCount = 0;
+		m_Stop = false;
+
+		for (size_t i = 0; i <= threads; i++)
+			m_Queues.push_back(std::make_unique<Queue>());
+
+		for (size_t i = 0; i < threads; i++)
+			m_Workers.push_back(std::thread(&ThreadPool::WorkerLoop, this, i));
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		WaitAll();
+
+		{
+			std::lock_guard<std::mutex> lock(m_SleepMutex);
+			m_Stop = true;
+		}
+
+		m_WakeUp.notify_all();
+
+		for (auto& worker : m_Workers)
+			worker.join();
+	}
+
+	ThreadPool::TaskHandle ThreadPool::Schedule(const std::function<void()>& func, const std::vector<TaskHandle>& dependencies)
+	{
+		TaskHandle task = std::make_shared<Task>();
+
+		task->func = func;
+		task->isDone = false;
+
+		// Holds the task back until all of the dependencies are registered
+		task->dependencies = 1;
+
+		m_UnfinishedCount++;
+
+		for (const auto& dependency : dependencies)
+		{
+			std::lock_guard<std::mutex> lock(dependency->mutex);
+
+			if (!dependency->isDone)
+			{
+				dependency->continuations.push_back(task);
+				task->dependencies++;
+			}
+		}
+
+		if (--task->dependencies == 0)
+			Push(task);
+
+		return task;
+	}
+
+	void ThreadPool::Wait(const TaskHandle& task)
+	{
+		while (!task->isDone)
+		{
+			if (!RunPending())
+				std::this_thread::yield();
+		}
+	}
+
+	void ThreadPool::WaitAll()
+	{
+		assert(s_CurrentPool != this && "ThreadPool::WaitAll can't be called from a worker of the pool");
+
+		while (m_UnfinishedCount > 0)
+		{
+			if (!RunPending())
+				std::this_thread::yield();
+		}
+	}
+
+	template <class F>
+	void ThreadPool::ParallelFor(int begin, int end, int grain, F&& func)
+	{
+		if (begin >= end)
+			return;
+
+		if (grain <= 0)
+			grain = std::max(1, (end - begin) / int(4 * (m_Workers.size() + 1)));
+
+		std::vector<TaskHandle> tasks;
+		tasks.reserve((end - begin + grain - 1) / grain);
+
+		for (int start = begin; start < end; start += grain)
+		{
+			int stop = std::min(start + grain, end);
+
+			tasks.push_back(Schedule([&func, start, stop]()
+				{
+					for (int i = start; i < stop; i++)
+						func(i);
+				}));
+		}
+
+		for (const auto& task : tasks)
+			Wait(task);
+	}
+
+	size_t ThreadPool::GetWorkerCount() const
+	{
+		return m_Workers.size();
+	}
+
+	void ThreadPool::Push(const TaskHandle& task)
+	{
+		size_t index = (s_CurrentPool == this) ? s_CurrentQueue : m_Workers.size();
+
+		{
+			std::lock_guard<std::mutex> lock(m_Queues[index]->mutex);
+			m_Queues[index]->tasks.push_back(task);
+		}
+
+		m_QueuedCount++;
+
+		{
+			std::lock_guard<std::mutex> lock(m_SleepMutex);
+		}
+
+		m_WakeUp.notify_one();
+	}
+
+	ThreadPool::TaskHandle ThreadPool::Pop()
+	{
+		size_t own = (s_CurrentPool == this) ? s_CurrentQueue : m_Workers.size();
+
+		{
+			std::lock_guard<std::mutex> lock(m_Queues[own]->mutex);
+			auto& tasks = m_Queues[own]->tasks;
+
+			if (!tasks.empty())
+			{
+				TaskHandle task = tasks.back();
+				tasks.pop_back();
+
+				m_QueuedCount--;
+				return task;
+			}
+		}
+
+		for (size_t i = 1; i < m_Queues.size(); i++)
+		{
+			Queue& victim = *m_Queues[(own + i) % m_Queues.size()];
+
+			std::lock_guard<std::mutex> lock(victim.mutex);
+
+			if (!victim.tasks.empty())
+			{
+				TaskHandle task = victim.tasks.front();
+				victim.tasks.pop_front();
+
+				m_QueuedCount--;
+				return task;
+			}
+		}
+
+		return nullptr;
+	}
+
+	bool ThreadPool::RunPending()
+	{
+		TaskHandle task = Pop();
+
+		if (!task)
+			return false;
+
+		Run(task);
+		return true;
+	}
+
+	void ThreadPool::Run(const TaskHandle& task)
+	{
+		task->func();
+
+		// Releases the captures since the handle can outlive the task
+		task->func = nullptr;
+
+		std::vector<TaskHandle> continuations;
+
+		{
+			std::lock_guard<std::mutex> lock(task->mutex);
+
+			task->isDone = true;
+			continuations.swap(task->continuations);
+		}
+
+		for (const auto& next : continuations)
+		{
+			if (--next->dependencies == 0)
+				Push(next);
+		}
+
+		m_UnfinishedCount--;
+	}
+
+	void ThreadPool::WorkerLoop(size_t index)
+	{
+		s_CurrentPool = this;
+		s_CurrentQueue = index;
+
+		while (true)
+		{
+			if (RunPending())
+				continue;
+
+			std::unique_lock<std::mutex> lock(m_SleepMutex);
+			m_WakeUp.wait(lock, [this] { return m_Stop || m_QueuedCount > 0; });
+
+			if (m_Stop)
+				break;
+		}
+	}
+
+	SpatialHash::SpatialHash(float cellSize)
+	{
+		SetCellSize(cellSize);
+
+		m_Count = 0;
+		m_BucketMask = 0;
+		m_BucketStart = { 0, 0 };
+	}
+
+	void SpatialHash::SetCellSize(float cellSize)
+	{
+		m_CellSize = cellSize;
+		m_InvCellSize = 1.0f / cellSize;
+	}
+
+	float SpatialHash::GetCellSize() const
+	{
+		return m_CellSize;
+	}
+
+	void SpatialHash::Clear()
+	{
+		m_Min.clear();
+		m_Max.clear();
+		m_IsAlive.clear();
+		m_Count = 0;
+
+		m_FirstCell.clear();
+		m_LastCell.clear();
+
+		m_Entries.clear();
+		m_BucketStart = { 0, 0 };
+		m_BucketMask = 0;
+	}
+
+	void SpatialHash::Insert(uint32_t id, const vf2d& pos, const vf2d& size)
+	{
+		if (id >= m_IsAlive.size())
+		{
+			m_Min.resize(id + 1);
+			m_Max.resize(id + 1);
+			m_IsAlive.resize(id + 1, false);
+		}
+
+		if (!m_IsAlive[id])
+		{
+			m_IsAlive[id] = true;
+			m_Count++;
+		}
+
+		m_Min[id] = pos.min(pos + size);
+		m_Max[id] = pos.max(pos + size);
+	}
+
+	void SpatialHash::Move(uint32_t id, const vf2d& pos, const vf2d& size)
+	{
+		Insert(id, pos, size);
+	}
+
+	void SpatialHash::Remove(uint32_t id)
+	{
+		if (Contains(id))
+		{
+			m_IsAlive[id] = false;
+			m_Count--;
+		}
+	}
+
+	bool SpatialHash::Contains(uint32_t id) const
+	{
+		return id < m_IsAlive.size() && m_IsAlive[id];
+	}
+
+	size_t SpatialHash::GetCount() const
+	{
+		return m_Count;
+	}
+
+	vi2d SpatialHash::GetCell(const vf2d& pos) const
+	{
+		return { (int)floorf(pos.x * m_InvCellSize), (int)floorf(pos.y * m_InvCellSize) };
+	}
+
+	uint32_t SpatialHash::GetBucket(const vi2d& cell) const
+	{
+		return ((uint32_t)cell.x * 73856093u ^ (uint32_t)cell.y * 19349663u) & m_BucketMask;
+	}
+
+	void SpatialHash::Rebuild()
+	{
+		// Counting the covered cells first so the table can be sized before hashing
+		size_t entries = 0;
+
+		m_FirstCell.resize(m_IsAlive.size());
+		m_LastCell.resize(m_IsAlive.size());
+
+		for (size_t id = 0; id < m_IsAlive.size(); id++)
+		{
+			if (m_IsAlive[id])
+			{
+				m_FirstCell[id] = GetCell(m_Min[id]);
+				m_LastCell[id] = GetCell(m_Max[id]);
+
+				vi2d cells = m_LastCell[id] - m_FirstCell[id] + 1;
+				entries += size_t(cells.x) * size_t(cells.y);
+			}
+		}
+
+		size_t buckets = 16;
+		while (buckets < entries)
+			buckets <<= 1;
+
+		m_BucketMask = uint32_t(buckets - 1);
+		m_BucketStart.assign(buckets + 1, 0);
+		m_Entries.resize(entries);
+
+		auto ForEachCell = [this](size_t id, auto&& func)
+			{
+				for (int y = m_FirstCell[id].y; y <= m_LastCell[id].y; y++)
+					for (int x = m_FirstCell[id].x; x <= m_LastCell[id].x; x++)
+						func(vi2d(x, y));
+			};
+
+		for (size_t id = 0; id < m_IsAlive.size(); id++)
+		{
+			if (m_IsAlive[id])
+				ForEachCell(id, [this](const vi2d& cell) { m_BucketStart[GetBucket(cell) + 1]++; });
+		}
+
+		for (size_t i = 0; i < buckets; i++)
+			m_BucketStart[i + 1] += m_BucketStart[i];
+
+		for (size_t id = 0; id < m_IsAlive.size(); id++)
+		{
+			if (!m_IsAlive[id])
+				continue;
+
+			ForEachCell(id, [&](const vi2d& cell)
+				{
+					Entry& entry = m_Entries[m_BucketStart[GetBucket(cell)]++];
+
+					entry.min = m_Min[id];
+					entry.max = m_Max[id];
+					entry.cell = cell;
+					entry.id = uint32_t(id);
+				});
+		}
+
+		// Every start was moved to the end of its bucket which is the start of the next one
+		for (size_t i = buckets; i > 0; i--)
+			m_BucketStart[i] = m_BucketStart[i - 1];
+
+		m_BucketStart[0] = 0;
+	}
+
+	template <class F>
+	void SpatialHash::Query(const vf2d& min, const vf2d& max, F&& func) const
+	{
+		vi2d first = GetCell(min);
+		vi2d last = GetCell(max);
+
+		auto Overlaps = [&](const Entry& entry)
+			{
+				return entry.min.x <= max.x && entry.min.y <= max.y && entry.max.x >= min.x && entry.max.y >= min.y;
+			};
+
+		// Large queries read the entries linearly instead of visiting every cell
+		if (int64_t(last.x - first.x + 1) * int64_t(last.y - first.y + 1) > int64_t(m_Entries.size()))
+		{
+			for (const Entry& entry : m_Entries)
+			{
+				// The entry of the first covered cell represents the object
+				if (entry.cell == GetCell(entry.min) && Overlaps(entry))
+					func(entry);
+			}
+
+			return;
+		}
+
+		for (int y = first.y; y <= last.y; y++)
+			for (int x = first.x; x <= last.x; x++)
+			{
+				vi2d cell(x, y);
+				uint32_t bucket = GetBucket(cell);
+
+				for (uint32_t i = m_BucketStart[bucket]; i < m_BucketStart[bucket + 1]; i++)
+				{
+					const Entry& entry = m_Entries[i];
+
+					if (entry.cell != cell || !Overlaps(entry))
+						continue;
+
+					// An object that covers several cells of the query is reported
+					// only from the first cell that both of them cover
+					if (cell == GetCell(entry.min.max(min)))
+						func(entry);
+				}
+			}
 	}
 
-	void Texture::Update(Sprite* sprite)
-	{
-#ifdef PLATFORM_GL
-		glBindTexture(GL_TEXTURE_2D, id);
+	void SpatialHash::QueryRect(const vf2d& pos, const vf2d& size, std::vector<uint32_t>& ids) const
+	{
+		Query(pos.min(pos + size), pos.max(pos + size), [&](const Entry& entry) { ids.push_back(entry.id); });
+	}
+
+	void SpatialHash::QueryCircle(const vf2d& centre, float radius, std::vector<uint32_t>& ids) const
+	{
+		Query(centre - radius, centre + radius, [&](const Entry& entry)
+			{
+				vf2d closest = centre.max(entry.min).min(entry.max);
+
+				if ((closest - centre).mag2() <= radius * radius)
+					ids.push_back(entry.id);
+			});
+	}
+
+	void SpatialHash::FindPairs(std::vector<std::pair<uint32_t, uint32_t>>& pairs) const
+	{
+		for (size_t bucket = 0; bucket + 1 < m_BucketStart.size(); bucket++)
+		{
+			uint32_t begin = m_BucketStart[bucket];
+			uint32_t end = m_BucketStart[bucket + 1];
+
+			for (uint32_t i = begin; i < end; i++)
+			{
+				const Entry& a = m_Entries[i];
+
+				for (uint32_t j = i + 1; j < end; j++)
+				{
+					const Entry& b = m_Entries[j];
+
+					// Different cells can share a bucket
+					if (a.cell != b.cell)
+						continue;
+
+					if (a.min.x > b.max.x || a.min.y > b.max.y || a.max.x < b.min.x || a.max.y < b.min.y)
+						continue;
+
+					// Objects that share several cells are reported from the first one
+					if (a.cell != GetCell(a.min.max(b.min)))
+						continue;
+
+					pairs.push_back(a.id < b.id ? std::make_pair(a.id, b.id) : std::make_pair(b.id, a.id));
+				}
+			}
+		}
+	}
+
+	ParticleSystem::ParticleSystem(size_t capacity)
+	{
+		m_Capacity = capacity;
+
+		m_Drag = 0.0f;
+		m_Fade = false;
+
+		m_Seed = 0x9E3779B9u;
+	}
+
+	void ParticleSystem::SetGravity(const vf2d& gravity)
+	{
+		m_Gravity = gravity;
+	}
+
+	vf2d ParticleSystem::GetGravity() const
+	{
+		return m_Gravity;
+	}
+
+	void ParticleSystem::SetDrag(float drag)
+	{
+		m_Drag = drag;
+	}
+
+	float ParticleSystem::GetDrag() const
+	{
+		return m_Drag;
+	}
+
+	void ParticleSystem::SetFade(bool enable)
+	{
+		m_Fade = enable;
+	}
+
+	bool ParticleSystem::Emit(const vf2d& pos, const vf2d& vel, float life, const Pixel& col)
+	{
+		if (m_Capacity > 0 && m_PosX.size() >= m_Capacity)
+			return false;
+
+		m_PosX.push_back(pos.x);
+		m_PosY.push_back(pos.y);
+		m_VelX.push_back(vel.x);
+		m_VelY.push_back(vel.y);
+		m_Age.push_back(0.0f);
+		m_Life.push_back(life);
+		m_Colours.push_back(col);
+
+		return true;
+	}
+
+	size_t ParticleSystem::AddEmitter(const Emitter& emitter)
+	{
+		m_Emitters.push_back(emitter);
+		return m_Emitters.size() - 1;
+	}
+
+	ParticleSystem::Emitter& ParticleSystem::GetEmitter(size_t index)
+	{
+		return m_Emitters[index];
+	}
+
+	void ParticleSystem::ClearEmitters()
+	{
+		m_Emitters.clear();
+	}
+
+	float ParticleSystem::Random(float min, float max)
+	{
+		// xorshift32
+		m_Seed ^= m_Seed << 13;
+		m_Seed ^= m_Seed >> 17;
+		m_Seed ^= m_Seed << 5;
+
+		return min + (max - min) * float(m_Seed >> 8) * (1.0f / 16777216.0f);
+	}
+
+	void ParticleSystem::Update(float deltaTime, ThreadPool* pool)
+	{
+		for (Emitter& emitter : m_Emitters)
+		{
+			if (!emitter.isActive)
+				continue;
+
+			emitter.accumulator += emitter.rate * deltaTime;
+
+			for (; emitter.accumulator >= 1.0f; emitter.accumulator -= 1.0f)
+			{
+				float angle = emitter.angle + Random(-0.5f, 0.5f) * emitter.spread;
+				float speed = Random(emitter.minSpeed, emitter.maxSpeed);
+
+				vf2d pos = emitter.pos + emitter.size * vf2d(Random(0.0f, 1.0f), Random(0.0f, 1.0f));
+				vf2d vel = vf2d(cosf(angle), sinf(angle)) * speed;
+
+				if (!Emit(pos, vel, Random(emitter.minLife, emitter.maxLife), emitter.colour))
+				{
+					emitter.accumulator = 0.0f;
+					break;
+				}
+			}
+		}
+
+		// Chunks are big enough to amortize the scheduling and are aligned to the vector width
+		constexpr size_t CHUNK_SIZE = 16384;
+		size_t count = m_PosX.size();
+
+		if (pool && count > CHUNK_SIZE)
+		{
+			int chunks = int((count + CHUNK_SIZE - 1) / CHUNK_SIZE);
+
+			pool->ParallelFor(0, chunks, 1, [&](int chunk)
+				{
+					size_t begin = size_t(chunk) * CHUNK_SIZE;
+					Integrate(begin, std::min(begin + CHUNK_SIZE, count), deltaTime);
+				});
+		}
+		else
+			Integrate(0, count, deltaTime);
+
+		RemoveDead();
+	}
+
+	void ParticleSystem::Integrate(size_t begin, size_t end, float deltaTime)
+	{
+		// Local pointers let the compiler vectorize without reloading the vectors
+		float* posX = m_PosX.data();
+		float* posY = m_PosY.data();
+		float* velX = m_VelX.data();
+		float* velY = m_VelY.data();
+		float* age = m_Age.data();
+
+		float gravityX = m_Gravity.x * deltaTime;
+		float gravityY = m_Gravity.y * deltaTime;
+		float damping = std::max(0.0f, 1.0f - m_Drag * deltaTime);
+
+		for (size_t i = begin; i < end; i++)
+		{
+			velX[i] = (velX[i] + gravityX) * damping;
+			velY[i] = (velY[i] + gravityY) * damping;
+
+			posX[i] += velX[i] * deltaTime;
+			posY[i] += velY[i] * deltaTime;
+
+			age[i] += deltaTime;
+		}
+	}
+
+	void ParticleSystem::RemoveDead()
+	{
+		size_t count = m_PosX.size();
+
+		for (size_t i = 0; i < count;)
+		{
+			if (m_Age[i] < m_Life[i])
+			{
+				i++;
+				continue;
+			}
+
+			count--;
+
+			m_PosX[i] = m_PosX[count];
+			m_PosY[i] = m_PosY[count];
+			m_VelX[i] = m_VelX[count];
+			m_VelY[i] = m_VelY[count];
+			m_Age[i] = m_Age[count];
+			m_Life[i] = m_Life[count];
+			m_Colours[i] = m_Colours[count];
+		}
+
+		m_PosX.resize(count);
+		m_PosY.resize(count);
+		m_VelX.resize(count);
+		m_VelY.resize(count);
+		m_Age.resize(count);
+		m_Life.resize(count);
+		m_Colours.resize(count);
+	}
+
+	void ParticleSystem::Clear()
+	{
+		m_PosX.clear();
+		m_PosY.clear();
+		m_VelX.clear();
+		m_VelY.clear();
+		m_Age.clear();
+		m_Life.clear();
+		m_Colours.clear();
+	}
+
+	Pixel ParticleSystem::GetColour(size_t i) const
+	{
+		Pixel col = m_Colours[i];
+
+		if (m_Fade)
+			col.a = uint8_t((float)col.a * std::max(0.0f, 1.0f - m_Age[i] / m_Life[i]));
+
+		return col;
+	}
+
+	bool ParticleSystem::IsRectVisible(float left, float top, int size, const vi2d& screenSize)
+	{
+		// Checked before the conversion to int so the particles far away can't overflow it
+		return left < (float)screenSize.x && top < (float)screenSize.y && left + (float)size > 0.0f && top + (float)size > 0.0f;
+	}
+
+	void ParticleSystem::Draw(GameEngine* engine, int size)
+	{
+		Graphic* drawTarget = engine->GetDrawTarget();
+
+		if (!drawTarget || size <= 0)
+			return;
+
+		Sprite* target = drawTarget->sprite;
+		size_t count = m_PosX.size();
+
+		// Other modes need the destination pixel or the shader so they go through the engine
+		if (engine->GetPixelMode() != Pixel::Mode::DEFAULT)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				float left = floorf(m_PosX[i]) - float(size / 2);
+				float top = floorf(m_PosY[i]) - float(size / 2);
+
+				if (!IsRectVisible(left, top, size, target->size))
+					continue;
+
+				Pixel col = GetColour(i);
+
+				int x = int(left);
+				int y = int(top);
+
+				for (int j = 0; j < size; j++)
+					for (int k = 0; k < size; k++)
+						engine->Draw(x + k, y + j, col);
+			}
+
+			return;
+		}
+
+		Pixel* pixels = target->pixels.data();
+		int width = target->size.x;
+		int height = target->size.y;
+
+		uint64_t written = 0;
+
+		if (size == 1)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				// Truncation would move the particles in (-1, 0) onto the screen
+				float x = floorf(m_PosX[i]);
+				float y = floorf(m_PosY[i]);
+
+				if (x >= 0.0f && x < (float)width && y >= 0.0f && y < (float)height)
+				{
+					pixels[int(y) * width + int(x)] = m_Colours[i];
+					written++;
+				}
+			}
+		}
+		else
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				float left = floorf(m_PosX[i]) - float(size / 2);
+				float top = floorf(m_PosY[i]) - float(size / 2);
+
+				if (!IsRectVisible(left, top, size, target->size))
+					continue;
 
-		glTexImage2D(
-			GL_TEXTURE_2D,
-			0, GL_RGBA,
-			sprite->size.x,
-			sprite->size.y,
-			0, GL_RGBA,
-			GL_UNSIGNED_BYTE,
-			sprite->pixels.data()
-		);
+				int x1 = std::max(int(left), 0);
+				int y1 = std::max(int(top), 0);
+				int x2 = std::min(int(left) + size, width);
+				int y2 = std::min(int(top) + size, height);
 
-		glBindTexture(GL_TEXTURE_2D, 0);
+				for (int y = y1; y < y2; y++)
+					std::fill(pixels + y * width + x1, pixels + y * width + x2, m_Colours[i]);
+
+				written += uint64_t(x2 - x1) * uint64_t(y2 - y1);
+			}
+		}
+
+#ifdef DGE_FRAME_STATS
+		engine->AddPixelsWritten(written);
 #else
-#error Consider defining PLATFORM_GL macro
+		UNUSED(written);
 #endif
 	}
 
-	Graphic::Graphic(std::string_view fileName)
+	void ParticleSystem::DrawTextures(GameEngine* engine, float size, const Texture* tex)
 	{
-		Load(fileName);
-	}
+		size_t count = m_PosX.size();
 
-	Graphic::Graphic(const vi2d& size)
-	{
-		Load(size);
-	}
+		if (count == 0)
+			return;
 
-	Graphic::~Graphic()
-	{
-		delete texture;
-		delete sprite;
+		TextureInstance& texInst = engine->m_Textures.emplace_back();
+
+		texInst.texture = tex;
+		texInst.structure = Texture::Structure::DEFAULT;
+		texInst.points = uint32_t(count * 6);
+		texInst.drawBeforeTransforms = engine->m_DrawBeforeTransforms;
+		texInst.view = engine->GetViewIndex();
+
+		texInst.vertices.resize(count * 6);
+		texInst.uv.resize(count * 6);
+		texInst.tint.resize(count * 6);
+
+		// Two triangles per particle written straight in NDC
+		vf2d scale = vf2d(2.0f, -2.0f) * engine->m_InvScreenSize;
+		vf2d half = vf2d(size, size) * 0.5f * scale;
+
+		const vf2d corners[6] = { { -1.0f, -1.0f }, { -1.0f, 1.0f }, { 1.0f, 1.0f }, { -1.0f, -1.0f }, { 1.0f, 1.0f }, { 1.0f, -1.0f } };
+		const vf2d uv[6] = { { 0.0f, 0.0f }, { 0.0f, 1.0f }, { 1.0f, 1.0f }, { 0.0f, 0.0f }, { 1.0f, 1.0f }, { 1.0f, 0.0f } };
+
+		for (size_t i = 0; i < count; i++)
+		{
+			vf2d centre = vf2d(m_PosX[i], m_PosY[i]) * scale + vf2d(-1.0f, 1.0f);
+			Pixel col = GetColour(i);
+
+			for (size_t j = 0; j < 6; j++)
+			{
+				texInst.vertices[i * 6 + j] = centre + corners[j] * half;
+				texInst.uv[i * 6 + j] = uv[j];
+				texInst.tint[i * 6 + j] = col;
+			}
+		}
 	}
 
-	void Graphic::Load(std::string_view fileName)
+	size_t ParticleSystem::GetCount() const
 	{
-		sprite = new Sprite(fileName);
-		texture = new Texture(sprite);
+		return m_PosX.size();
 	}
 
-	void Graphic::Load(const vi2d& size)
+	size_t ParticleSystem::GetCapacity() const
 	{
-		sprite = new Sprite(size);
-		texture = new Texture(sprite);
+		return m_Capacity;
 	}
 
-	void Graphic::Save(std::string_view fileName, const Sprite::FileType type) const
+	vf2d ParticleSystem::GetPosition(size_t i) const
 	{
-		return sprite->Save(fileName, type);
+		return { m_PosX[i], m_PosY[i] };
 	}
 
-	void Graphic::UpdateTexture()
+	vf2d ParticleSystem::GetVelocity(size_t i) const
 	{
-		texture->Update(sprite);
+		return { m_VelX[i], m_VelY[i] };
 	}
 
 	TextureInstance::TextureInstance()
@@ -1919,6 +4102,7 @@ namespace def
 		uv = { { 0.0f, 0.0f }, { 0.0f, 1.0f }, { 1.0f, 1.0f }, { 1.0f, 0.0f } };
 
 		drawBeforeTransforms = false;
+		view = 0;
 	}
 
 #ifdef PLATFORM_GL
@@ -1975,6 +4159,21 @@ namespace def
 		glEnd();
 	}
 
+	void Platform_GL::SetViewTransform(const mat3& transform)
+	{
+		// Column-major 4x4 matrix with the 2D transform in the xy plane
+		float m[16] =
+		{
+			transform.m[0][0], transform.m[1][0], 0.0f, 0.0f,
+			transform.m[0][1], transform.m[1][1], 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f, 0.0f,
+			transform.m[0][2], transform.m[1][2], 0.0f, 1.0f
+		};
+
+		glMatrixMode(GL_MODELVIEW);
+		glLoadMatrixf(m);
+	}
+
 	void Platform_GL::BindTexture(int id) const
 	{
 		glBindTexture(GL_TEXTURE_2D, id);
@@ -1989,6 +4188,7 @@ namespace def
 	bool Platform_GL::GetMouse(int button) const { UNUSED(button); return false; }
 	void Platform_GL::FlushScreen(bool vsync) const { UNUSED(vsync); }
 	void Platform_GL::PollEvents() const {}
+	void Platform_GL::SetVSync(bool enable) const { UNUSED(enable); }
 
 	bool Platform_GL::ConstructWindow(vi2d& screenSize, const vi2d pixelSize, vi2d& windowSize, bool vsync, bool fullscreen, bool dirtypixel)
 	{
@@ -2003,6 +4203,9 @@ namespace def
 
 	void Platform_GL::SetIcon(Sprite& icon) const { UNUSED(icon); }
 
+	void Platform_GL::AcquireContext() const {}
+	void Platform_GL::ReleaseContext() const {}
+
 #endif
 
 #ifdef PLATFORM_GL_WINDOWS
@@ -2048,6 +4251,12 @@ namespace def
 		if (vsync) DwmFlush();
 	}
 
+	void Platform_GL_Windows::SetVSync(bool enable) const
+	{
+		if (wglSwapInterval)
+			wglSwapInterval(enable ? 1 : 0);
+	}
+
 	void Platform_GL_Windows::PollEvents() const
 	{
 		MSG msg;
@@ -2153,6 +4362,16 @@ namespace def
 		// TODO: Not implemented yet
 	}
 
+	void Platform_GL_Windows::AcquireContext() const
+	{
+		wglMakeCurrent(m_DeviceContext, m_RenderContext);
+	}
+
+	void Platform_GL_Windows::ReleaseContext() const
+	{
+		wglMakeCurrent(NULL, NULL);
+	}
+
 	LRESULT CALLBACK Platform_GL_Windows::WindowEvent(HWND window, UINT message, WPARAM param1, LPARAM param2)
 	{
 		GameEngine* e = GameEngine::s_Engine;
@@ -2303,86 +4522,382 @@ namespace def
 		return glfwGetMouseButton(m_Window, button) == GLFW_PRESS;
 	}
 
-	void Platform_GLFW3::FlushScreen(bool vsync) const
+	void Platform_GLFW3::FlushScreen(bool vsync) const
+	{
+		// The window is always double buffered, vsync only changes the swap interval
+		UNUSED(vsync);
+		glfwSwapBuffers(m_Window);
+	}
+
+	void Platform_GLFW3::SetVSync(bool enable) const
+	{
+		glfwSwapInterval(enable ? 1 : 0);
+	}
+
+	void Platform_GLFW3::PollEvents() const
+	{
+		glfwPollEvents();
+	}
+
+	bool Platform_GLFW3::ConstructWindow(vi2d& screenSize, const vi2d pixelSize, vi2d& windowSize, bool vsync, bool fullscreen, bool dirtypixel)
+	{
+		m_Monitor = glfwGetPrimaryMonitor();
+
+		if (!m_Monitor)
+			return false;
+
+		const GLFWvidmode* videoMode = glfwGetVideoMode(m_Monitor);
+		if (!videoMode) return false;
+
+		if (fullscreen)
+		{
+			windowSize = { videoMode->width, videoMode->height };
+			screenSize = windowSize / pixelSize;
+
+			m_Window = glfwCreateWindow(windowSize.x, windowSize.y, "", m_Monitor, NULL);
+			if (!m_Window) return false;
+
+			glfwSetWindowMonitor(
+				m_Window,
+				m_Monitor,
+				0, 0,
+				windowSize.x, windowSize.y,
+				videoMode->refreshRate
+			);
+		}
+		else
+		{
+			m_Window = glfwCreateWindow(windowSize.x, windowSize.y, "", NULL, NULL);
+
+			if (!m_Window)
+				return false;
+		}
+
+		glfwMakeContextCurrent(m_Window);
+		glViewport(0, 0, windowSize.x, windowSize.y);
+
+		glEnable(GL_TEXTURE_2D);
+
+		if (!dirtypixel)
+			glHint(GL_PERSPECTIVE_CORRECTION_HINT, GL_NICEST);
+
+		glfwSwapInterval(vsync ? 1 : 0);
+
+		if (vsync)
+			glfwWindowHint(GLFW_REFRESH_RATE, videoMode->refreshRate);
+
+		glfwSetDropCallback(m_Window, DropCallback);
+
+		glfwSetScrollCallback(m_Window, ScrollCallback);
+		glfwSetCursorPosCallback(m_Window, MousePosCallback);
+
+		return true;
+	}
+
+	void Platform_GLFW3::SetIcon(Sprite& icon) const
+	{
+		GLFWimage img;
+		img.width = icon.size.x;
+		img.height = icon.size.y;
+		img.pixels = (uint8_t*)icon.pixels.data();
+
+		glfwSetWindowIcon(m_Window, 1, &img);
+	}
+
+	void Platform_GLFW3::AcquireContext() const
+	{
+		glfwMakeContextCurrent(m_Window);
+	}
+
+	void Platform_GLFW3::ReleaseContext() const
+	{
+		glfwMakeContextCurrent(nullptr);
+	}
+
+#endif
+
+#ifdef PLATFORM_HEADLESS
+
+	Platform_Headless::Platform_Headless()
+	{
+		m_BoundTexture = 0;
+		m_IsClosed = false;
+		m_HasViewTransform = false;
+
+		for (int i = 0; i < 512; i++)
+			m_Keys[i] = false;
+
+		for (int i = 0; i < 8; i++)
+			m_Mouse[i] = false;
+	}
+
+	void Platform_Headless::Destroy() const
+	{
+		s_Textures.clear();
+		s_FreeTextures.clear();
+	}
+
+	void Platform_Headless::SetTitle(const std::string& text) const { UNUSED(text); }
+
+	bool Platform_Headless::IsWindowClose() const { return m_IsClosed; }
+	bool Platform_Headless::IsWindowFocused() const { return true; }
+
+	bool Platform_Headless::GetKey(int key) const { return m_Keys[key]; }
+	bool Platform_Headless::GetMouse(int button) const { return m_Mouse[button]; }
+
+	void Platform_Headless::ClearBuffer(const Pixel& col) const
+	{
+		m_Framebuffer.SetPixelData(col);
+	}
+
+	void Platform_Headless::OnBeforeDraw() {}
+	void Platform_Headless::OnAfterDraw() {}
+
+	void Platform_Headless::FlushScreen(bool vsync) const { UNUSED(vsync); }
+	void Platform_Headless::PollEvents() const {}
+	void Platform_Headless::SetVSync(bool enable) const { UNUSED(enable); }
+
+	void Platform_Headless::DrawQuad(const Pixel& tint) const
+	{
+		vf2d vertices[4] = { { -1.0f, -1.0f }, { -1.0f, 1.0f }, { 1.0f, 1.0f }, { 1.0f, -1.0f } };
+		vf2d uv[4] = { { 0.0f, 1.0f }, { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f } };
+		Pixel tints[4] = { tint, tint, tint, tint };
+
+		vf2d triangle[3] = { vertices[0], vertices[1], vertices[2] };
+		vf2d triangleUV[3] = { uv[0], uv[1], uv[2] };
+		RasterizeTriangle(triangle, triangleUV, tints);
+
+		triangle[1] = vertices[2]; triangle[2] = vertices[3];
+		triangleUV[1] = uv[2]; triangleUV[2] = uv[3];
+		RasterizeTriangle(triangle, triangleUV, tints);
+	}
+
+	void Platform_Headless::DrawTexture(const TextureInstance& texInst) const
+	{
+		BindTexture(texInst.texture ? texInst.texture->id : 0);
+
+		auto Draw = [&](uint32_t i1, uint32_t i2, uint32_t i3)
+			{
+				vf2d vertices[3] = { texInst.vertices[i1], texInst.vertices[i2], texInst.vertices[i3] };
+
+				if (m_HasViewTransform)
+					m_ViewTransform.transform(vertices, vertices, 3);
+				vf2d uv[3] = { texInst.uv[i1], texInst.uv[i2], texInst.uv[i3] };
+				Pixel tint[3] = { texInst.tint[i1], texInst.tint[i2], texInst.tint[i3] };
+
+				RasterizeTriangle(vertices, uv, tint);
+			};
+
+		switch (texInst.structure)
+		{
+		case Texture::Structure::DEFAULT:
+		{
+			for (uint32_t i = 0; i + 2 < texInst.points; i += 3)
+				Draw(i, i + 1, i + 2);
+		}
+		break;
+
+		case Texture::Structure::FAN:
+		{
+			for (uint32_t i = 1; i + 1 < texInst.points; i++)
+				Draw(0, i, i + 1);
+		}
+		break;
+
+		case Texture::Structure::STRIP:
+		{
+			for (uint32_t i = 0; i + 2 < texInst.points; i++)
+				Draw(i, i + 1, i + 2);
+		}
+		break;
+
+		case Texture::Structure::WIREFRAME:
+		{
+			uint32_t lines = texInst.points > 2 ? texInst.points : texInst.points - 1;
+
+			for (uint32_t i = 0; i < lines && texInst.points > 1; i++)
+			{
+				uint32_t j = (i + 1) % texInst.points;
+
+				vf2d vertices[2] = { texInst.vertices[i], texInst.vertices[j] };
+
+				if (m_HasViewTransform)
+					m_ViewTransform.transform(vertices, vertices, 2);
+				vf2d uv[2] = { texInst.uv[i], texInst.uv[j] };
+				Pixel tint[2] = { texInst.tint[i], texInst.tint[j] };
+
+				RasterizeLine(vertices, uv, tint);
+			}
+		}
+		break;
+
+		}
+	}
+
+	void Platform_Headless::SetViewTransform(const mat3& transform)
+	{
+		m_ViewTransform = transform;
+
+		m_HasViewTransform =
+			transform.m[0][0] != 1.0f || transform.m[0][1] != 0.0f || transform.m[0][2] != 0.0f ||
+			transform.m[1][0] != 0.0f || transform.m[1][1] != 1.0f || transform.m[1][2] != 0.0f;
+	}
+
+	void Platform_Headless::BindTexture(int id) const
+	{
+		m_BoundTexture = id;
+	}
+
+	bool Platform_Headless::ConstructWindow(vi2d& screenSize, const vi2d pixelSize, vi2d& windowSize, bool vsync, bool fullscreen, bool dirtypixel)
+	{
+		UNUSED(pixelSize);
+		UNUSED(windowSize);
+		UNUSED(vsync);
+		UNUSED(fullscreen);
+		UNUSED(dirtypixel);
+
+		m_Framebuffer.Create(screenSize);
+		return true;
+	}
+
+	void Platform_Headless::SetIcon(Sprite& icon) const { UNUSED(icon); }
+
+	void Platform_Headless::AcquireContext() const {}
+	void Platform_Headless::ReleaseContext() const {}
+
+	void Platform_Headless::SetKey(int key, bool held)
+	{
+		m_Keys[key] = held;
+	}
+
+	void Platform_Headless::SetMouse(int button, bool held)
+	{
+		m_Mouse[button] = held;
+	}
+
+	void Platform_Headless::SetMousePos(const vi2d& pos)
+	{
+		GameEngine::s_Engine->m_MousePos = pos;
+	}
+
+	void Platform_Headless::SetScrollDelta(int delta)
+	{
+		GameEngine::s_Engine->m_ScrollDelta = delta;
+	}
+
+	void Platform_Headless::Close()
+	{
+		m_IsClosed = true;
+	}
+
+	const Sprite& Platform_Headless::GetFramebuffer() const
+	{
+		return m_Framebuffer;
+	}
+
+	vf2d Platform_Headless::ToScreen(const vf2d& vertex) const
 	{
-		if (vsync)
-			glfwSwapBuffers(m_Window);
-		else
-			glFlush();
+		return vf2d((vertex.x + 1.0f) * 0.5f, (1.0f - vertex.y) * 0.5f) * m_Framebuffer.size;
 	}
 
-	void Platform_GLFW3::PollEvents() const
+	Pixel Platform_Headless::SampleTexture(const vf2d& uv, const Pixel& tint) const
 	{
-		glfwPollEvents();
+		if (m_BoundTexture <= 0 || m_BoundTexture > (int)s_Textures.size())
+			return tint;
+
+		const Sprite& tex = s_Textures[m_BoundTexture - 1];
+
+		// Nearest filtering with GL_REPEAT wrapping
+		int x = (int)std::floor(uv.x * (float)tex.size.x) % tex.size.x;
+		int y = (int)std::floor(uv.y * (float)tex.size.y) % tex.size.y;
+
+		if (x < 0) x += tex.size.x;
+		if (y < 0) y += tex.size.y;
+
+		const Pixel& texel = tex.pixels[y * tex.size.x + x];
+
+		return Pixel(
+			uint8_t(texel.r * tint.r / 255),
+			uint8_t(texel.g * tint.g / 255),
+			uint8_t(texel.b * tint.b / 255),
+			uint8_t(texel.a * tint.a / 255)
+		);
 	}
 
-	bool Platform_GLFW3::ConstructWindow(vi2d& screenSize, const vi2d pixelSize, vi2d& windowSize, bool vsync, bool fullscreen, bool dirtypixel)
+	void Platform_Headless::BlendPixel(int x, int y, const Pixel& col) const
 	{
-		m_Monitor = glfwGetPrimaryMonitor();
+		Pixel& dst = m_Framebuffer.pixels[y * m_Framebuffer.size.x + x];
 
-		if (!m_Monitor)
-			return false;
+		int a = col.a;
+		int ia = 255 - a;
 
-		if (!vsync)
-			glfwWindowHint(GLFW_DOUBLEBUFFER, GLFW_FALSE);
+		dst.r = uint8_t((col.r * a + dst.r * ia) / 255);
+		dst.g = uint8_t((col.g * a + dst.g * ia) / 255);
+		dst.b = uint8_t((col.b * a + dst.b * ia) / 255);
+		dst.a = uint8_t((col.a * a + dst.a * ia) / 255);
+	}
 
-		const GLFWvidmode* videoMode = glfwGetVideoMode(m_Monitor);
-		if (!videoMode) return false;
+	void Platform_Headless::RasterizeTriangle(const vf2d* vertices, const vf2d* uv, const Pixel* tint) const
+	{
+		vf2d p[3] = { ToScreen(vertices[0]), ToScreen(vertices[1]), ToScreen(vertices[2]) };
 
-		if (fullscreen)
-		{
-			windowSize = { videoMode->width, videoMode->height };
-			screenSize = windowSize / pixelSize;
+		float area = (p[1] - p[0]).cross(p[2] - p[0]);
 
-			m_Window = glfwCreateWindow(windowSize.x, windowSize.y, "", m_Monitor, NULL);
-			if (!m_Window) return false;
+		if (area == 0.0f)
+			return;
 
-			glfwSetWindowMonitor(
-				m_Window,
-				m_Monitor,
-				0, 0,
-				windowSize.x, windowSize.y,
-				videoMode->refreshRate
-			);
-		}
-		else
-		{
-			m_Window = glfwCreateWindow(windowSize.x, windowSize.y, "", NULL, NULL);
+		float invArea = 1.0f / area;
 
-			if (!m_Window)
-				return false;
-		}
+		vi2d start = p[0].min(p[1]).min(p[2]).floor();
+		vi2d end = p[0].max(p[1]).max(p[2]).ceil();
 
-		glfwMakeContextCurrent(m_Window);
-		glViewport(0, 0, windowSize.x, windowSize.y);
+		start = start.max({ 0, 0 });
+		end = end.min(m_Framebuffer.size);
 
-		glEnable(GL_TEXTURE_2D);
+		vi2d pixel;
+		for (pixel.y = start.y; pixel.y < end.y; pixel.y++)
+			for (pixel.x = start.x; pixel.x < end.x; pixel.x++)
+			{
+				// Sample at the pixel center as OpenGL does
+				vf2d c = vf2d(pixel) + 0.5f;
 
-		if (!dirtypixel)
-			glHint(GL_PERSPECTIVE_CORRECTION_HINT, GL_NICEST);
+				float w0 = (p[2] - p[1]).cross(c - p[1]) * invArea;
+				float w1 = (p[0] - p[2]).cross(c - p[2]) * invArea;
+				float w2 = 1.0f - w0 - w1;
 
-		if (vsync)
-		{
-			glfwSwapInterval(1);
-			glfwWindowHint(GLFW_REFRESH_RATE, videoMode->refreshRate);
-		}
+				if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+					continue;
 
-		glfwSetDropCallback(m_Window, DropCallback);
+				vf2d texCoord = uv[0] * w0 + uv[1] * w1 + uv[2] * w2;
 
-		glfwSetScrollCallback(m_Window, ScrollCallback);
-		glfwSetCursorPosCallback(m_Window, MousePosCallback);
+				Pixel col(
+					uint8_t(tint[0].r * w0 + tint[1].r * w1 + tint[2].r * w2),
+					uint8_t(tint[0].g * w0 + tint[1].g * w1 + tint[2].g * w2),
+					uint8_t(tint[0].b * w0 + tint[1].b * w1 + tint[2].b * w2),
+					uint8_t(tint[0].a * w0 + tint[1].a * w1 + tint[2].a * w2)
+				);
 
-		return true;
+				BlendPixel(pixel.x, pixel.y, SampleTexture(texCoord, col));
+			}
 	}
 
-	void Platform_GLFW3::SetIcon(Sprite& icon) const
+	void Platform_Headless::RasterizeLine(const vf2d* vertices, const vf2d* uv, const Pixel* tint) const
 	{
-		GLFWimage img;
-		img.width = icon.size.x;
-		img.height = icon.size.y;
-		img.pixels = (uint8_t*)icon.pixels.data();
+		vf2d p1 = ToScreen(vertices[0]);
+		vf2d p2 = ToScreen(vertices[1]);
 
-		glfwSetWindowIcon(m_Window, 1, &img);
+		int steps = (int)std::ceil(std::max(std::abs(p2.x - p1.x), std::abs(p2.y - p1.y)));
+
+		for (int i = 0; i <= steps; i++)
+		{
+			float t = steps > 0 ? (float)i / (float)steps : 0.0f;
+			vi2d pixel = p1.lerp(p2, t).floor();
+
+			if (pixel.x < 0 || pixel.y < 0 || pixel.x >= m_Framebuffer.size.x || pixel.y >= m_Framebuffer.size.y)
+				continue;
+
+			BlendPixel(pixel.x, pixel.y, SampleTexture(uv[0].lerp(uv[1], t), tint[0].lerp(tint[1], t)));
+		}
 	}
 
 #endif
@@ -2407,20 +4922,45 @@ namespace def
 		m_DeltaTime = 0.0f;
 		m_TickTimer = 0.0f;
 
+		m_ReplayDeltaTime = 0.0f;
+		m_CloseOnReplayEnd = true;
+
 		m_Shader = nullptr;
+		m_CullMode = CullMode::BACK;
 		s_Engine = this;
 
 		m_PickedConsoleHistoryCommand = 0;
 
-		MakeUnitCircle(s_UnitCircle, 64); // TODO: Make 64 (vertices count) as constant
+		for (size_t i = 0; i < UNIT_CIRCLE_LODS; i++)
+			MakeUnitCircle(s_UnitCircles[i], (8 << i) + 1);
 
 		m_OnlyTextures = false;
 		m_DrawBeforeTransforms = false;
+		m_UseViewTransform = false;
+		m_ViewIndex = 0;
+
+		m_IsPipelined = false;
+		m_HasPendingFrame = false;
+		m_IsRendering = false;
+		m_StopRendering = false;
+		m_AfterDrawResult = true;
+
+		m_FrameCap = 0.0f;
+
+		m_RenderTime = 0.0f;
+		m_DrawCalls = 0;
+		m_TextureInstances = 0;
+
+		m_TextureMemory = 0;
+		m_UploadBytes = 0;
+		m_PixelsWritten = 0;
 
 #if defined(PLATFORM_GL_WINDOWS)
 		m_Platform = new Platform_GL_Windows();
 #elif defined(PLATFORM_GLFW3)
 		m_Platform = new Platform_GLFW3();
+#elif defined(PLATFORM_HEADLESS)
+		m_Platform = new Platform_Headless();
 #else
 		#error No platform was selected
 #endif
@@ -2429,6 +4969,9 @@ namespace def
 	GameEngine::~GameEngine()
 	{
 		Destroy();
+
+		if (s_Engine == this)
+			s_Engine = nullptr;
 	}
 
 	void GameEngine::Destroy()
@@ -2488,6 +5031,12 @@ namespace def
 
 		m_Platform->SetTitle("github.com/defini7 - defGameEngine - " + m_AppName + " - FPS: 0");
 
+		if (m_IsPipelined)
+		{
+			m_Platform->ReleaseContext();
+			m_RenderThread = std::thread(&GameEngine::RenderThread, this);
+		}
+
 		int frames = 0;
 
 		while (m_IsAppRunning)
@@ -2502,8 +5051,35 @@ namespace def
 			if (m_Platform->IsWindowClose())
 				m_IsAppRunning = false;
 
-			ScanHardware(m_Keys, m_KeyNewState, m_KeyOldState, 512, &Platform::GetKey);
-			ScanHardware(m_Mouse, m_MouseNewState, m_MouseOldState, 8, &Platform::GetMouse);
+			if (m_ReplayFile.is_open() && !ReadInputFrame())
+			{
+				StopReplay();
+
+				if (m_CloseOnReplayEnd)
+					m_IsAppRunning = false;
+			}
+
+			if (m_ReplayFile.is_open())
+			{
+				if (m_ReplayDeltaTime > 0.0f)
+					m_DeltaTime = m_ReplayDeltaTime;
+				else
+					m_DeltaTime = m_ReplayedFrame.deltaTime;
+
+				m_MousePos = m_ReplayedFrame.mousePos;
+				m_ScrollDelta = m_ReplayedFrame.scrollDelta;
+
+				ScanHardware(m_Keys, m_KeyNewState, m_KeyOldState, 512, [this](Platform*, int i) { return m_ReplayedFrame.keys[i]; });
+				ScanHardware(m_Mouse, m_MouseNewState, m_MouseOldState, 8, [this](Platform*, int i) { return m_ReplayedFrame.mouse[i]; });
+			}
+			else
+			{
+				ScanHardware(m_Keys, m_KeyNewState, m_KeyOldState, 512, &Platform::GetKey);
+				ScanHardware(m_Mouse, m_MouseNewState, m_MouseOldState, 8, &Platform::GetMouse);
+			}
+
+			if (m_RecordFile.is_open())
+				WriteInputFrame();
 
 			if (m_Keys[280].pressed) // Caps Lock
 				m_Caps = !m_Caps;
@@ -2607,6 +5183,8 @@ namespace def
 				}
 			}
 
+			auto updateStart = std::chrono::system_clock::now();
+
 			if (!OnUserUpdate(m_DeltaTime))
 				m_IsAppRunning = false;
 
@@ -2614,7 +5192,10 @@ namespace def
 
 			if (m_ShowConsole)
 			{
+				bool useViewTransform = m_UseViewTransform;
+
 				m_DrawBeforeTransforms = true;
+				m_UseViewTransform = false;
 
 				FillTextureRectangle({ 0, 0 }, m_ScreenSize, m_ConsoleBackgroundColour);
 
@@ -2636,49 +5217,322 @@ namespace def
 				DrawTextureLine({ x, y }, { x, y + 8 }, RED);
 
 				m_DrawBeforeTransforms = false;
+				m_UseViewTransform = useViewTransform;
 			}
 
-			m_Platform->ClearBuffer(m_ClearBufferColour);
-			m_Platform->OnBeforeDraw();
+			auto submitStart = std::chrono::system_clock::now();
+
+			if (!m_OnlyTextures)
+				m_DrawTarget->UpdateTexture();
+
+			SubmitFrame();
+
+			auto submitEnd = std::chrono::system_clock::now();
+
+			m_FrameStats.frameTime = m_DeltaTime;
+			m_FrameStats.updateTime = std::chrono::duration<float>(submitStart - updateStart).count();
+			m_FrameStats.submitTime = std::chrono::duration<float>(submitEnd - submitStart).count();
+			m_FrameStats.textureMemory = m_TextureMemory.load(std::memory_order_relaxed);
+			m_FrameStats.uploadBytes = m_UploadBytes.exchange(0, std::memory_order_relaxed);
+			m_FrameStats.pixelsWritten = m_PixelsWritten.exchange(0, std::memory_order_relaxed);
 
-			for (const auto& texture : m_Textures)
+			m_Platform->PollEvents();
+
+			if (m_FrameCap > 0.0f)
 			{
-				if (texture.drawBeforeTransforms)
-					m_Platform->DrawTexture(texture);
+				auto frameTime = std::chrono::duration<float>(1.0f / m_FrameCap);
+				std::this_thread::sleep_until(startTime + std::chrono::duration_cast<std::chrono::system_clock::duration>(frameTime));
 			}
 
-			if (!m_OnlyTextures)
+			frames++;
+			if (m_TickTimer >= 1.0f)
 			{
-				m_DrawTarget->UpdateTexture();
+				m_Platform->SetTitle("github.com/defini7 - defGameEngine - " + m_AppName + " - FPS: " + std::to_string(frames));
 
-				m_Platform->BindTexture(m_DrawTarget->texture->id);
-				m_Platform->DrawQuad(m_ClearBufferColour);
+				m_TickTimer = 0.0f;
+				frames = 0;
 			}
+		}
 
-			for (const auto& texture : m_Textures)
+		if (m_RenderThread.joinable())
+		{
 			{
-				if (!texture.drawBeforeTransforms)
-					m_Platform->DrawTexture(texture);
+				std::lock_guard<std::mutex> lock(m_RenderMutex);
+				m_StopRendering = true;
 			}
 
-			m_Textures.clear();
+			m_RenderCondition.notify_all();
+			m_RenderThread.join();
+
+			m_Platform->AcquireContext();
+		}
+	}
+
+	void GameEngine::SubmitFrame()
+	{
+		std::unique_lock<std::mutex> lock(m_RenderMutex);
+
+		// Waiting for the previous frame so only one frame is in flight
+		if (m_RenderThread.joinable())
+		{
+			m_RenderCondition.wait(lock, [this] { return !m_HasPendingFrame && !m_IsRendering; });
+
+			// The render thread is idle so the stats of the previous frame can be read
+			CollectRenderStats();
+		}
+
+		// Swapping keeps the capacity of both buffers between frames
+		std::swap(m_PendingFrame.textures, m_Textures);
+		std::swap(m_PendingFrame.commands, m_RenderCommands);
+
+		m_PendingFrame.screen = m_OnlyTextures ? nullptr : m_DrawTarget->texture;
+		m_PendingFrame.clearColour = m_ClearBufferColour;
+		m_PendingFrame.vsync = m_IsVSync;
 
-			if (!OnAfterDraw())
+		std::swap(m_PendingFrame.views, m_Views);
+		m_Views.clear();
+		m_ViewIndex = 0;
+
+		if (m_RenderThread.joinable())
+		{
+			if (!m_AfterDrawResult)
 				m_IsAppRunning = false;
 
-			m_Platform->OnAfterDraw();
-			m_Platform->FlushScreen(m_IsVSync);
-			m_Platform->PollEvents();
+			m_HasPendingFrame = true;
 
-			frames++;
-			if (m_TickTimer >= 1.0f)
+			lock.unlock();
+			m_RenderCondition.notify_all();
+		}
+		else
+		{
+			if (!DrawFrame(m_PendingFrame))
+				m_IsAppRunning = false;
+
+			CollectRenderStats();
+		}
+	}
+
+	void GameEngine::CollectRenderStats()
+	{
+		m_FrameStats.renderTime = m_RenderTime;
+		m_FrameStats.drawCalls = m_DrawCalls;
+		m_FrameStats.textureInstances = m_TextureInstances;
+	}
+
+	bool GameEngine::DrawFrame(FrameData& frame)
+	{
+		auto renderStart = std::chrono::system_clock::now();
+
+		for (const auto& command : frame.commands)
+			command();
+
+		m_Platform->ClearBuffer(frame.clearColour);
+		m_Platform->OnBeforeDraw();
+
+		uint32_t view = 0;
+
+		// The transform is only changed between the runs of textures with different views
+		auto DrawTexture = [&](const TextureInstance& texture)
 			{
-				m_Platform->SetTitle("github.com/defini7 - defGameEngine - " + m_AppName + " - FPS: " + std::to_string(frames));
+				if (texture.view != view)
+				{
+					view = texture.view;
+					m_Platform->SetViewTransform(view ? frame.views[view - 1] : mat3());
+				}
 
-				m_TickTimer = 0.0f;
-				frames = 0;
+				m_Platform->DrawTexture(texture);
+			};
+
+		for (const auto& texture : frame.textures)
+		{
+			if (texture.drawBeforeTransforms)
+				DrawTexture(texture);
+		}
+
+		if (frame.screen)
+		{
+			if (view)
+			{
+				view = 0;
+				m_Platform->SetViewTransform(mat3());
+			}
+
+			m_Platform->BindTexture(frame.screen->id);
+			m_Platform->DrawQuad(frame.clearColour);
+		}
+
+		m_DrawCalls = uint32_t(frame.textures.size()) + (frame.screen ? 1 : 0);
+		m_TextureInstances = uint32_t(frame.textures.size());
+
+		for (const auto& texture : frame.textures)
+		{
+			if (!texture.drawBeforeTransforms)
+				DrawTexture(texture);
+		}
+
+		if (view)
+			m_Platform->SetViewTransform(mat3());
+
+		frame.commands.clear();
+		frame.textures.clear();
+		frame.views.clear();
+
+		bool result = OnAfterDraw();
+
+		m_Platform->OnAfterDraw();
+
+		if (frame.vsync != m_IsContextVSync)
+		{
+			m_Platform->SetVSync(frame.vsync);
+			m_IsContextVSync = frame.vsync;
+		}
+
+		m_Platform->FlushScreen(frame.vsync);
+
+		m_RenderTime = std::chrono::duration<float>(std::chrono::system_clock::now() - renderStart).count();
+
+		return result;
+	}
+
+	void GameEngine::RenderThread()
+	{
+		m_Platform->AcquireContext();
+
+		FrameData frame;
+
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(m_RenderMutex);
+				m_RenderCondition.wait(lock, [this] { return m_HasPendingFrame || m_StopRendering; });
+
+				if (!m_HasPendingFrame)
+					break;
+
+				std::swap(frame, m_PendingFrame);
+
+				m_HasPendingFrame = false;
+				m_IsRendering = true;
+			}
+
+			bool result = DrawFrame(frame);
+
+			{
+				std::lock_guard<std::mutex> lock(m_RenderMutex);
+
+				m_IsRendering = false;
+
+				if (!result)
+					m_AfterDrawResult = false;
+			}
+
+			m_RenderCondition.notify_all();
+		}
+
+		m_Platform->ReleaseContext();
+	}
+
+	bool GameEngine::NeedsDeferredRendering() const
+	{
+		return m_RenderThread.joinable() && m_RenderThread.get_id() != std::this_thread::get_id();
+	}
+
+	uint32_t GameEngine::GetViewIndex()
+	{
+		if (!m_UseViewTransform)
+			return 0;
+
+		if (m_ViewIndex == 0)
+		{
+			// Conjugating by the screen to NDC mapping lets the vertices stay in NDC
+			mat3 ndc(2.0f * m_InvScreenSize.x, 0.0f, -1.0f, 0.0f, -2.0f * m_InvScreenSize.y, 1.0f);
+
+			m_Views.push_back(ndc * m_ViewTransform * ndc.invert());
+			m_ViewIndex = uint32_t(m_Views.size());
+		}
+
+		return m_ViewIndex;
+	}
+
+	void GameEngine::WaitForRenderThread()
+	{
+		std::unique_lock<std::mutex> lock(m_RenderMutex);
+		m_RenderCondition.wait(lock, [this] { return !m_HasPendingFrame && !m_IsRendering; });
+	}
+
+	/*
+	* Each frame is stored as: delta time, mouse position, scroll delta,
+	* mouse buttons as a bit mask and a list of keys that changed their state
+	* since the previous frame
+	*/
+
+	void GameEngine::WriteInputFrame()
+	{
+		auto Write = [this](const auto& value)
+			{
+				m_RecordFile.write((const char*)&value, sizeof(value));
+			};
+
+		uint8_t mouse = 0;
+		for (int i = 0; i < 8; i++)
+		{
+			if (m_MouseNewState[i])
+				mouse |= 1 << i;
+		}
+
+		std::vector<uint16_t> changedKeys;
+		for (int i = 0; i < 512; i++)
+		{
+			if (m_KeyNewState[i] != m_RecordedFrame.keys[i])
+			{
+				m_RecordedFrame.keys[i] = m_KeyNewState[i];
+				changedKeys.push_back(i);
 			}
 		}
+
+		Write(m_DeltaTime);
+		Write((int32_t)m_MousePos.x);
+		Write((int32_t)m_MousePos.y);
+		Write((int32_t)m_ScrollDelta);
+		Write(mouse);
+		Write((uint16_t)changedKeys.size());
+
+		for (uint16_t key : changedKeys)
+			Write(key);
+	}
+
+	bool GameEngine::ReadInputFrame()
+	{
+		auto Read = [this](auto& value)
+			{
+				return (bool)m_ReplayFile.read((char*)&value, sizeof(value));
+			};
+
+		int32_t mouseX, mouseY, scrollDelta;
+		uint8_t mouse;
+		uint16_t changedKeys;
+
+		if (!Read(m_ReplayedFrame.deltaTime) || !Read(mouseX) || !Read(mouseY) ||
+			!Read(scrollDelta) || !Read(mouse) || !Read(changedKeys))
+			return false;
+
+		m_ReplayedFrame.mousePos = { mouseX, mouseY };
+		m_ReplayedFrame.scrollDelta = scrollDelta;
+
+		for (int i = 0; i < 8; i++)
+			m_ReplayedFrame.mouse[i] = mouse & (1 << i);
+
+		for (uint16_t i = 0; i < changedKeys; i++)
+		{
+			uint16_t key;
+
+			if (!Read(key) || key >= 512)
+				return false;
+
+			m_ReplayedFrame.keys[key] = !m_ReplayedFrame.keys[key];
+		}
+
+		return true;
 	}
 
 	void GameEngine::MakeUnitCircle(std::vector<vf2d>& circle, const size_t verts)
@@ -2726,6 +5580,7 @@ namespace def
 
 		m_IsFullScreen = fullScreen;
 		m_IsVSync = vsync;
+		m_IsContextVSync = vsync;
 
 		m_IsDirtyPixel = dirtyPixel;
 
@@ -2794,19 +5649,22 @@ namespace def
 			return false;
 
 		Sprite* target = m_DrawTarget->sprite;
+		bool isWritten = false;
 
 		switch (m_PixelMode)
 		{
 		case Pixel::Mode::CUSTOM:
-			return target->SetPixel(x, y, m_Shader({ x, y }, target->GetPixel(x, y), col));
+			isWritten = target->SetPixel(x, y, m_Shader({ x, y }, target->GetPixel(x, y), col));
+		break;
 
 		case Pixel::Mode::DEFAULT:
-			return target->SetPixel(x, y, col);
+			isWritten = target->SetPixel(x, y, col);
+		break;
 
 		case Pixel::Mode::MASK:
 		{
 			if (col.a == 255)
-				return target->SetPixel(x, y, col);
+				isWritten = target->SetPixel(x, y, col);
 		}
 		break;
 
@@ -2818,12 +5676,18 @@ namespace def
 			uint8_t g = uint8_t(std::lerp(d.g, col.g, (float)col.a / 255.0f));
 			uint8_t b = uint8_t(std::lerp(d.b, col.b, (float)col.a / 255.0f));
 
-			return target->SetPixel(x, y, { r, g, b });
+			isWritten = target->SetPixel(x, y, { r, g, b });
 		}
+		break;
 
 		}
 
-		return false;
+#ifdef DGE_FRAME_STATS
+		if (isWritten)
+			m_PixelsWritten.fetch_add(1, std::memory_order_relaxed);
+#endif
+
+		return isWritten;
 	}
 
 	void GameEngine::DrawLine(int x1, int y1, int x2, int y2, const Pixel& col)
@@ -3417,6 +6281,7 @@ namespace def
 		texInst.vertices.resize(texInst.points);
 		texInst.uv = { { 0.0f, 0.0f}, {0.0f, 1.0f}, {1.0f, 1.0f}, {1.0f, 0.0f} };
 		texInst.drawBeforeTransforms = m_DrawBeforeTransforms;
+		texInst.view = GetViewIndex();
 
 		float rd = ((points[2].x - points[0].x) * (points[3].y - points[1].y) - (points[3].x - points[1].x) * (points[2].y - points[0].y));
 
@@ -3448,34 +6313,38 @@ namespace def
 	}
 
 	void GameEngine::DrawWireFrameModel(const std::vector<vf2d>& modelCoordinates, float x, float y, float rotation, float scale, const Pixel& col)
+	{
+		DrawWireFrameModel(modelCoordinates, mat3::translate({ x, y }) * mat3::rotate(rotation) * mat3::scale({ scale, scale }), col);
+	}
+
+	void GameEngine::FillWireFrameModel(const std::vector<vf2d>& modelCoordinates, float x, float y, float rotation, float scale, const Pixel& col)
+	{
+		FillWireFrameModel(modelCoordinates, mat3::translate({ x, y }) * mat3::rotate(rotation) * mat3::scale({ scale, scale }), col);
+	}
+
+	void GameEngine::DrawWireFrameModel(const std::vector<vf2d>& modelCoordinates, const mat3& transform, const Pixel& col)
 	{
 		size_t verts = modelCoordinates.size();
 
-		std::vector<vf2d> coordinates(verts);
-		float cs = cosf(rotation), sn = sinf(rotation);
+		if (verts == 0)
+			return;
 
-		for (size_t i = 0; i < verts; i++)
-		{
-			coordinates[i].x = (modelCoordinates[i].x * cs - modelCoordinates[i].y * sn) * scale + x;
-			coordinates[i].y = (modelCoordinates[i].x * sn + modelCoordinates[i].y * cs) * scale + y;
-		}
+		std::vector<vf2d> coordinates(verts);
+		transform.transform(modelCoordinates.data(), coordinates.data(), verts);
 
 		for (size_t i = 0; i <= verts; i++)
 			DrawLine(coordinates[i % verts], coordinates[(i + 1) % verts], col);
 	}
 
-	void GameEngine::FillWireFrameModel(const std::vector<vf2d>& modelCoordinates, float x, float y, float rotation, float scale, const Pixel& col)
+	void GameEngine::FillWireFrameModel(const std::vector<vf2d>& modelCoordinates, const mat3& transform, const Pixel& col)
 	{
 		size_t verts = modelCoordinates.size();
 
-		std::vector<vf2d> coordinates(verts);
-		float cs = cosf(rotation), sn = sinf(rotation);
+		if (verts == 0)
+			return;
 
-		for (size_t i = 0; i < verts; i++)
-		{
-			coordinates[i].x = (modelCoordinates[i].x * cs - modelCoordinates[i].y * sn) * scale + x;
-			coordinates[i].y = (modelCoordinates[i].x * sn + modelCoordinates[i].y * cs) * scale + y;
-		}
+		std::vector<vf2d> coordinates(verts);
+		transform.transform(modelCoordinates.data(), coordinates.data(), verts);
 
 		auto GetAngle = [](const vf2d& p1, const vf2d& p2)
 			{
@@ -3580,6 +6449,31 @@ namespace def
 	bool GameEngine::IsFullScreen() const { return m_IsFullScreen; }
 	bool GameEngine::IsVSync() const { return m_IsVSync; }
 
+	void GameEngine::SetVSync(bool enable)
+	{
+		m_IsVSync = enable;
+	}
+
+	void GameEngine::SetFrameCap(float fps)
+	{
+		m_FrameCap = fps;
+	}
+
+	float GameEngine::GetFrameCap() const
+	{
+		return m_FrameCap;
+	}
+
+	const FrameStats& GameEngine::GetFrameStats() const
+	{
+		return m_FrameStats;
+	}
+
+	void GameEngine::AddPixelsWritten(uint64_t count)
+	{
+		m_PixelsWritten.fetch_add(count, std::memory_order_relaxed);
+	}
+
 	bool GameEngine::IsFocused() const
 	{
 		return m_Platform->IsWindowFocused();
@@ -3632,143 +6526,605 @@ namespace def
 		return m_TextureStructure;
 	}
 
-	bool GameEngine::Draw(const vi2d& pos, const Pixel& p)
-	{
-		return Draw(pos.x, pos.y, p);
-	}
+	bool GameEngine::Draw(const vi2d& pos, const Pixel& p)
+	{
+		return Draw(pos.x, pos.y, p);
+	}
+
+	void GameEngine::DrawLine(const vi2d& pos1, const vi2d& pos2, const Pixel& col)
+	{
+		DrawLine(pos1.x, pos1.y, pos2.x, pos2.y, col);
+	}
+
+	void GameEngine::DrawTexturePolygon(const std::vector<vf2d>& verts, const std::vector<Pixel>& cols, Texture::Structure structure)
+	{
+		TextureInstance texInst;
+
+		texInst.texture = nullptr;
+		texInst.points = verts.size();
+		texInst.structure = structure;
+
+		texInst.tint.resize(verts.size());
+
+		if (cols.size() > 1)
+		{
+			std::copy(
+				cols.begin(),
+				cols.end(),
+				texInst.tint.begin());
+		}
+		else
+		{
+			std::fill(
+				texInst.tint.begin(),
+				texInst.tint.end(),
+				cols[0]);
+		}
+
+		texInst.uv.resize(verts.size());
+		texInst.vertices.resize(verts.size());
+
+		for (size_t i = 0; i < verts.size(); i++)
+		{
+			texInst.vertices[i].x = verts[i].x * m_InvScreenSize.x * 2.0f - 1.0f;
+			texInst.vertices[i].y = 1.0f - verts[i].y * m_InvScreenSize.y * 2.0f;
+		}
+
+		texInst.drawBeforeTransforms = m_DrawBeforeTransforms;
+		texInst.view = GetViewIndex();
+
+		m_Textures.push_back(texInst);
+	}
+
+	void GameEngine::DrawTextureLine(const vi2d& pos1, const vi2d& pos2, const Pixel& col)
+	{
+		DrawTexturePolygon({ pos1, pos2 }, { col, col }, Texture::Structure::WIREFRAME);
+	}
+
+	void GameEngine::DrawTextureTriangle(const vi2d& pos1, const vi2d& pos2, const vi2d& pos3, const Pixel& col)
+	{
+		DrawTexturePolygon({ pos1, pos2, pos3 }, { col, col, col }, Texture::Structure::WIREFRAME);
+	}
+
+	void GameEngine::FillTextureTriangle(const vi2d& pos1, const vi2d& pos2, const vi2d& pos3, const Pixel& col)
+	{
+		DrawTexturePolygon({ pos1, pos2, pos3 }, { col, col, col }, Texture::Structure::FAN);
+	}
+
+	void GameEngine::DrawTextureRectangle(const vi2d& pos, const vi2d& size, const Pixel& col)
+	{
+		DrawTexturePolygon({ pos, { float(pos.x + size.x), (float)pos.y }, pos + size, { (float)pos.x, float(pos.y + size.y) } }, { col, col, col, col }, Texture::Structure::WIREFRAME);
+	}
+
+	void GameEngine::FillTextureRectangle(const vi2d& pos, const vi2d& size, const Pixel& col)
+	{
+		DrawTexturePolygon({ pos, { float(pos.x + size.x), (float)pos.y }, pos + size, { (float)pos.x, float(pos.y + size.y) } }, { col, col, col, col }, Texture::Structure::FAN);
+	}
+
+	void GameEngine::DrawTextureCircle(const vi2d& pos, int radius, const Pixel& col)
+	{
+		PushTextureCircle(pos, radius, col, Texture::Structure::WIREFRAME);
+	}
+
+	void GameEngine::FillTextureCircle(const vi2d& pos, int radius, const Pixel& col)
+	{
+		PushTextureCircle(pos, radius, col, Texture::Structure::FAN);
+	}
+
+	const std::vector<vf2d>& GameEngine::GetUnitCircle(int radius) const
+	{
+		float windowRadius = float(radius * std::max(m_PixelSize.x, m_PixelSize.y));
+
+		// Keeps the distance between the circle and its chord (r * (1 - cos(pi / n))) under a quarter of a pixel
+		for (size_t i = 0; i < UNIT_CIRCLE_LODS - 1; i++)
+		{
+			float segments = float(8 << i);
+			float error = windowRadius * (1.0f - cosf(3.14159f / segments));
+
+			if (error <= 0.25f)
+				return s_UnitCircles[i];
+		}
+
+		return s_UnitCircles[UNIT_CIRCLE_LODS - 1];
+	}
+
+	void GameEngine::PushTextureCircle(const vi2d& pos, int radius, const Pixel& col, Texture::Structure structure)
+	{
+		int projectedRadius = radius;
+
+		// The level of detail depends on the size of the circle on the screen
+		if (m_UseViewTransform)
+		{
+			const auto& m = m_ViewTransform.m;
+
+			float scale = std::max(
+				std::sqrt(m[0][0] * m[0][0] + m[1][0] * m[1][0]),
+				std::sqrt(m[0][1] * m[0][1] + m[1][1] * m[1][1]));
+
+			projectedRadius = (int)std::ceil((float)radius * scale);
+		}
+
+		const std::vector<vf2d>& circle = GetUnitCircle(projectedRadius);
+		size_t verts = circle.size();
+
+		// Writes NDC coordinates directly into the frame's instance
+		TextureInstance& texInst = m_Textures.emplace_back();
+
+		texInst.texture = nullptr;
+		texInst.points = verts;
+		texInst.structure = structure;
+		texInst.drawBeforeTransforms = m_DrawBeforeTransforms;
+		texInst.view = GetViewIndex();
+
+		texInst.tint.assign(verts, col);
+		texInst.uv.resize(verts);
+		texInst.vertices.resize(verts);
+
+		vf2d scale = vf2d((float)radius, (float)radius) * m_InvScreenSize * vf2d(2.0f, -2.0f);
+		vf2d offset = vf2d(pos) * m_InvScreenSize * vf2d(2.0f, -2.0f) + vf2d(-1.0f, 1.0f);
+
+		for (size_t i = 0; i < verts; i++)
+			texInst.vertices[i] = circle[i] * scale + offset;
+	}
+
+	void GameEngine::GradientTextureTriangle(const vi2d& pos1, const vi2d& pos2, const vi2d& pos3, const Pixel& col1, const Pixel& col2, const Pixel& col3)
+	{
+		DrawTexturePolygon({ pos1, pos2, pos3 }, { col1, col2, col3 }, Texture::Structure::FAN);
+	}
+
+	void GameEngine::GradientTextureRectangle(const vi2d& pos, const vi2d& size, const Pixel& colTL, const Pixel& colTR, const Pixel& colBR, const Pixel& colBL)
+	{
+		DrawTexturePolygon({ pos, { float(pos.x + size.x), (float)pos.y }, pos + size, { (float)pos.x, float(pos.y + size.y) } }, { colTL, colTR, colBR, colBL }, Texture::Structure::FAN);
+	}
+
+	void GameEngine::DrawTextureString(const vi2d& pos, std::string_view text, const Pixel& col, const vf2d& scale)
+	{
+		vf2d p = { 0.0f, 0.0f };
+
+		for (auto c : text)
+		{
+			if (c == '\n')
+			{
+				p.x = 0;
+				p.y += 8.0f * scale.y;
+			}
+			else if (c == '\t')
+			{
+				p.x += 8.0f * float(m_TabSize) * scale.x;
+			}
+			else
+			{
+				vf2d offset((c - 32) % 16, (c - 32) / 16);
+
+				DrawPartialTexture(pos + p, m_Font.texture, offset * 8.0f, { 8.0f, 8.0f }, scale, col);
+				p.x += 8.0f * scale.x;
+			}
+		}
+	}
+
+	void GameEngine::DrawTriangle(const vi2d& pos1, const vi2d& pos2, const vi2d& pos3, const Pixel& col)
+	{
+		DrawTriangle(pos1.x, pos1.y, pos2.x, pos2.y, pos3.x, pos3.y, col);
+	}
+
+	void GameEngine::FillTriangle(const vi2d& pos1, const vi2d& pos2, const vi2d& pos3, const Pixel& col)
+	{
+		FillTriangle(pos1.x, pos1.y, pos2.x, pos2.y, pos3.x, pos3.y, col);
+	}
+
+	template <class Fragment>
+	void GameEngine::RasterizeTriangle(const vf2d& pos1, const vf2d& pos2, const vf2d& pos3, float w1, float w2, float w3, Fragment&& fragment) const
+	{
+		RasterizeTriangle(pos1, pos2, pos3, w1, w2, w3, std::forward<Fragment>(fragment), [](int, int) { return true; });
+	}
+
+	template <class Fragment, class TileTest>
+	void GameEngine::RasterizeTriangle(const vf2d& pos1, const vf2d& pos2, const vf2d& pos3, float w1, float w2, float w3, Fragment&& fragment, TileTest&& acceptTile) const
+	{
+		const float invW[3] = { 1.0f / w1, 1.0f / w2, 1.0f / w3 };
+
+		auto IsInside = [](const vf2d& pos)
+			{
+				return std::abs(pos.x) <= GUARD_BAND && std::abs(pos.y) <= GUARD_BAND;
+			};
+
+		if (IsInside(pos1) && IsInside(pos2) && IsInside(pos3))
+		{
+			const vf2d pos[3] = { pos1, pos2, pos3 };
+			RasterizeClipped(pos, nullptr, invW, fragment, acceptTile);
+			return;
+		}
+
+		/*
+		* The fixed point edge functions would overflow so the triangle is clipped
+		* to the guard band and the resulting polygon is drawn as a fan, every vertex
+		* keeps its barycentric weights in the whole triangle so the fragments get
+		* the same weights as if the triangle wasn't clipped
+		*/
+		struct Vertex
+		{
+			vf2d pos;
+			float weights[3];
+		};
+
+		// A triangle clipped by 4 planes has at most 7 vertices
+		Vertex polygon[2][7] =
+		{
+			{
+				{ pos1, { 1.0f, 0.0f, 0.0f } },
+				{ pos2, { 0.0f, 1.0f, 0.0f } },
+				{ pos3, { 0.0f, 0.0f, 1.0f } }
+			}
+		};
+
+		int count = 3;
+		int current = 0;
+
+		// The distances to the planes x >= -G, x <= G, y >= -G and y <= G
+		auto Distance = [](const vf2d& pos, int plane)
+			{
+				switch (plane)
+				{
+				case 0: return pos.x + GUARD_BAND;
+				case 1: return GUARD_BAND - pos.x;
+				case 2: return pos.y + GUARD_BAND;
+				default: return GUARD_BAND - pos.y;
+				}
+			};
+
+		for (int plane = 0; plane < 4 && count > 0; plane++)
+		{
+			const Vertex* in = polygon[current];
+			Vertex* out = polygon[current ^ 1];
+
+			int outCount = 0;
+
+			for (int i = 0; i < count; i++)
+			{
+				const Vertex& from = in[i];
+				const Vertex& to = in[(i + 1) % count];
+
+				float d1 = Distance(from.pos, plane);
+				float d2 = Distance(to.pos, plane);
+
+				if (d1 >= 0.0f)
+					out[outCount++] = from;
+
+				if ((d1 >= 0.0f) != (d2 >= 0.0f))
+				{
+					float t = d1 / (d1 - d2);
+					Vertex& v = out[outCount++];
+
+					v.pos = from.pos + (to.pos - from.pos) * t;
+
+					for (int k = 0; k < 3; k++)
+						v.weights[k] = from.weights[k] + (to.weights[k] - from.weights[k]) * t;
+				}
+			}
+
+			count = outCount;
+			current ^= 1;
+		}
+
+		const Vertex* clipped = polygon[current];
+
+		for (int i = 1; i + 1 < count; i++)
+		{
+			const vf2d pos[3] = { clipped[0].pos, clipped[i].pos, clipped[i + 1].pos };
+			const float weights[3][3] =
+			{
+				{ clipped[0].weights[0], clipped[0].weights[1], clipped[0].weights[2] },
+				{ clipped[i].weights[0], clipped[i].weights[1], clipped[i].weights[2] },
+				{ clipped[i + 1].weights[0], clipped[i + 1].weights[1], clipped[i + 1].weights[2] }
+			};
+
+			RasterizeClipped(pos, weights, invW, fragment, acceptTile);
+		}
+	}
+
+	template <class Fragment, class TileTest>
+	void GameEngine::RasterizeClipped(const vf2d* pos, const float (*weights)[3], const float* invW, Fragment& fragment, TileTest& acceptTile) const
+	{
+		constexpr int TILE_SIZE = DepthBuffer::TILE_SIZE;
+		constexpr int SUBPIXEL_BITS = 8;
+		constexpr int64_t ONE = 1 << SUBPIXEL_BITS;
+		constexpr int64_t HALF = ONE >> 1;
+
+		const int64_t x[3] = { llroundf(pos[0].x * ONE), llroundf(pos[1].x * ONE), llroundf(pos[2].x * ONE) };
+		const int64_t y[3] = { llroundf(pos[0].y * ONE), llroundf(pos[1].y * ONE), llroundf(pos[2].y * ONE) };
+
+		int64_t area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+
+		if (area == 0)
+			return;
+
+		// Both windings are accepted by flipping the edge functions of the negative one
+		int64_t sign = area > 0 ? 1 : -1;
+		float invArea = 1.0f / float(area * sign);
+
+		// Edge i is opposite to the vertex i so its value is the barycentric weight of that vertex
+		int64_t a[3], b[3], c[3], bias[3];
+
+		for (int i = 0; i < 3; i++)
+		{
+			int j = (i + 1) % 3, k = (i + 2) % 3;
+
+			a[i] = sign * (y[j] - y[k]);
+			b[i] = sign * (x[k] - x[j]);
+			c[i] = sign * (x[j] * y[k] - y[j] * x[k]);
+
+			// Top-left rule: pixels on the other edges belong to the neighbouring triangle
+			bool isTop = a[i] == 0 && b[i] > 0;
+			bool isLeft = a[i] > 0;
+
+			bias[i] = (isTop || isLeft) ? 0 : -1;
+		}
+
+		const vi2d& size = m_DrawTarget->sprite->size;
+
+		int minX = std::max(int(std::min({ x[0], x[1], x[2] }) >> SUBPIXEL_BITS), 0);
+		int minY = std::max(int(std::min({ y[0], y[1], y[2] }) >> SUBPIXEL_BITS), 0);
+		int maxX = std::min(int((std::max({ x[0], x[1], x[2] }) + ONE - 1) >> SUBPIXEL_BITS), size.x - 1);
+		int maxY = std::min(int((std::max({ y[0], y[1], y[2] }) + ONE - 1) >> SUBPIXEL_BITS), size.y - 1);
+
+		if (minX > maxX || minY > maxY)
+			return;
+
+		// The pixels are processed in 2x2 blocks inside of tiles
+		minX &= ~1;
+		minY &= ~1;
+
+		for (int ty = minY / TILE_SIZE * TILE_SIZE; ty <= maxY; ty += TILE_SIZE)
+			for (int tx = minX / TILE_SIZE * TILE_SIZE; tx <= maxX; tx += TILE_SIZE)
+			{
+				// The tile is skipped if all of its pixels are outside of an edge
+				bool isOutside = false;
+
+				for (int i = 0; i < 3 && !isOutside; i++)
+				{
+					int64_t corner = a[i] * (tx * ONE + HALF) + b[i] * (ty * ONE + HALF) + c[i];
+					int64_t farthest = corner + std::max(a[i], (int64_t)0) * (TILE_SIZE - 1) * ONE + std::max(b[i], (int64_t)0) * (TILE_SIZE - 1) * ONE;
+
+					isOutside = farthest + bias[i] < 0;
+				}
+
+				if (isOutside || !acceptTile(tx / TILE_SIZE, ty / TILE_SIZE))
+					continue;
+
+				int endX = std::min(tx + TILE_SIZE - 1, maxX);
+				int endY = std::min(ty + TILE_SIZE - 1, maxY);
+
+				for (int by = std::max(ty, minY); by <= endY; by += 2)
+					for (int bx = std::max(tx, minX); bx <= endX; bx += 2)
+					{
+						int64_t edges[3][4];
+
+						for (int i = 0; i < 3; i++)
+						{
+							int64_t origin = a[i] * (bx * ONE + HALF) + b[i] * (by * ONE + HALF) + c[i];
+
+							edges[i][0] = origin;
+							edges[i][1] = origin + a[i] * ONE;
+							edges[i][2] = origin + b[i] * ONE;
+							edges[i][3] = origin + (a[i] + b[i]) * ONE;
+						}
+
+						bool mask[4];
+
+						for (int l = 0; l < 4; l++)
+						{
+							mask[l] =
+								edges[0][l] + bias[0] >= 0 &&
+								edges[1][l] + bias[1] >= 0 &&
+								edges[2][l] + bias[2] >= 0;
+						}
+
+						for (int l = 0; l < 4; l++)
+						{
+							int px = bx + (l & 1);
+							int py = by + (l >> 1);
 
-	void GameEngine::DrawLine(const vi2d& pos1, const vi2d& pos2, const Pixel& col)
-	{
-		DrawLine(pos1.x, pos1.y, pos2.x, pos2.y, col);
-	}
+							if (!mask[l] || px > endX || py > endY)
+								continue;
 
-	void GameEngine::DrawTexturePolygon(const std::vector<vf2d>& verts, const std::vector<Pixel>& cols, Texture::Structure structure)
-	{
-		TextureInstance texInst;
+							float linear[3], perspective[3];
 
-		texInst.texture = nullptr;
-		texInst.points = verts.size();
-		texInst.structure = structure;
+							for (int i = 0; i < 3; i++)
+								linear[i] = float(edges[i][l]) * invArea;
 
-		texInst.tint.resize(verts.size());
+							// Maps the weights in the clipped triangle to the weights in the whole one
+							if (weights)
+							{
+								float local[3] = { linear[0], linear[1], linear[2] };
 
-		if (cols.size() > 1)
-		{
-			std::copy(
-				cols.begin(),
-				cols.end(),
-				texInst.tint.begin());
-		}
-		else
-		{
-			std::fill(
-				texInst.tint.begin(),
-				texInst.tint.end(),
-				cols[0]);
-		}
+								for (int i = 0; i < 3; i++)
+									linear[i] = local[0] * weights[0][i] + local[1] * weights[1][i] + local[2] * weights[2][i];
+							}
 
-		texInst.uv.resize(verts.size());
-		texInst.vertices.resize(verts.size());
+							for (int i = 0; i < 3; i++)
+								perspective[i] = linear[i] * invW[i];
 
-		for (size_t i = 0; i < verts.size(); i++)
-		{
-			texInst.vertices[i].x = verts[i].x * m_InvScreenSize.x * 2.0f - 1.0f;
-			texInst.vertices[i].y = 1.0f - verts[i].y * m_InvScreenSize.y * 2.0f;
-		}
+							float invSum = 1.0f / (perspective[0] + perspective[1] + perspective[2]);
 
-		texInst.drawBeforeTransforms = m_DrawBeforeTransforms;
+							for (int i = 0; i < 3; i++)
+								perspective[i] *= invSum;
 
-		m_Textures.push_back(texInst);
+							fragment(px, py, linear, perspective);
+						}
+					}
+			}
 	}
 
-	void GameEngine::DrawTextureLine(const vi2d& pos1, const vi2d& pos2, const Pixel& col)
+	void GameEngine::DrawTexturedTriangle(const vf2d& pos1, const vf2d& pos2, const vf2d& pos3, const vf2d& uv1, const vf2d& uv2, const vf2d& uv3, const Sprite* sprite, const Pixel& tint, float w1, float w2, float w3)
 	{
-		DrawTexturePolygon({ pos1, pos2 }, { col, col }, Texture::Structure::WIREFRAME);
-	}
+		RasterizeTriangle(pos1, pos2, pos3, w1, w2, w3, [&](int x, int y, const float* linear, const float* perspective)
+			{
+				UNUSED(linear);
 
-	void GameEngine::DrawTextureTriangle(const vi2d& pos1, const vi2d& pos2, const vi2d& pos3, const Pixel& col)
-	{
-		DrawTexturePolygon({ pos1, pos2, pos3 }, { col, col, col }, Texture::Structure::WIREFRAME);
-	}
+				vf2d uv = uv1 * perspective[0] + uv2 * perspective[1] + uv3 * perspective[2];
+				Pixel col = sprite->Sample(uv, Sprite::SampleMethod::LINEAR, Sprite::WrapMethod::REPEAT);
 
-	void GameEngine::FillTextureTriangle(const vi2d& pos1, const vi2d& pos2, const vi2d& pos3, const Pixel& col)
-	{
-		DrawTexturePolygon({ pos1, pos2, pos3 }, { col, col, col }, Texture::Structure::FAN);
-	}
+				if (tint != WHITE)
+				{
+					uint8_t alpha = uint8_t(col.a * tint.a / 255);
 
-	void GameEngine::DrawTextureRectangle(const vi2d& pos, const vi2d& size, const Pixel& col)
-	{
-		DrawTexturePolygon({ pos, { float(pos.x + size.x), (float)pos.y }, pos + size, { (float)pos.x, float(pos.y + size.y) } }, { col, col, col, col }, Texture::Structure::WIREFRAME);
+					col = col * tint;
+					col.a = alpha;
+				}
+
+				Draw(x, y, col);
+			});
 	}
 
-	void GameEngine::FillTextureRectangle(const vi2d& pos, const vi2d& size, const Pixel& col)
+	void GameEngine::DrawTriangle3D(const mat4& transform, const vf4d& pos1, const vf4d& pos2, const vf4d& pos3, const vf2d& uv1, const vf2d& uv2, const vf2d& uv3, const Sprite* sprite, const Pixel& tint)
 	{
-		DrawTexturePolygon({ pos, { float(pos.x + size.x), (float)pos.y }, pos + size, { (float)pos.x, float(pos.y + size.y) } }, { col, col, col, col }, Texture::Structure::FAN);
+		DrawMesh(transform, { pos1, pos2, pos3 }, { uv1, uv2, uv3 }, { 0, 1, 2 }, sprite, tint);
 	}
 
-	void GameEngine::DrawTextureCircle(const vi2d& pos, int radius, const Pixel& col)
+	void GameEngine::DrawMesh(const mat4& transform, const std::vector<vf4d>& positions, const std::vector<vf2d>& uvs, const std::vector<uint32_t>& indices, const Sprite* sprite, const Pixel& tint)
 	{
-		std::vector<vf2d> verts(s_UnitCircle.size());
+		struct ClipVertex
+		{
+			vf4d pos;
+			vf2d uv;
+		};
 
-		for (size_t i = 0; i < verts.size(); i++)
-			verts[i] = s_UnitCircle[i] * (float)radius + pos;
+		std::vector<vf4d> clip(positions.size());
+		transform.transform(positions.data(), clip.data(), positions.size());
 
-		DrawTexturePolygon(verts, { col }, Texture::Structure::WIREFRAME);
-	}
+		DepthBuffer* depth = m_DrawTarget->depth;
+		vf2d viewport = m_DrawTarget->sprite->size;
 
-	void GameEngine::FillTextureCircle(const vi2d& pos, int radius, const Pixel& col)
-	{
-		std::vector<vf2d> verts(s_UnitCircle.size());
+		auto DrawClipped = [&](const ClipVertex* verts)
+			{
+				vf2d screen[3];
+				float z[3];
 
-		for (size_t i = 0; i < verts.size(); i++)
-			verts[i] = s_UnitCircle[i] * (float)radius + pos;
+				for (int i = 0; i < 3; i++)
+				{
+					float invW = 1.0f / verts[i].pos.w;
+					vf2d ndc = { verts[i].pos.x * invW, verts[i].pos.y * invW };
 
-		DrawTexturePolygon(verts, { col }, Texture::Structure::FAN);
-	}
+					screen[i] = { (ndc.x * 0.5f + 0.5f) * viewport.x, (0.5f - ndc.y * 0.5f) * viewport.y };
+					z[i] = verts[i].pos.z * invW * 0.5f + 0.5f;
+				}
 
-	void GameEngine::GradientTextureTriangle(const vi2d& pos1, const vi2d& pos2, const vi2d& pos3, const Pixel& col1, const Pixel& col2, const Pixel& col3)
-	{
-		DrawTexturePolygon({ pos1, pos2, pos3 }, { col1, col2, col3 }, Texture::Structure::FAN);
-	}
+				// Y is flipped so the counter-clockwise triangles have a negative area on the screen
+				float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) - (screen[1].y - screen[0].y) * (screen[2].x - screen[0].x);
 
-	void GameEngine::GradientTextureRectangle(const vi2d& pos, const vi2d& size, const Pixel& colTL, const Pixel& colTR, const Pixel& colBR, const Pixel& colBL)
-	{
-		DrawTexturePolygon({ pos, { float(pos.x + size.x), (float)pos.y }, pos + size, { (float)pos.x, float(pos.y + size.y) } }, { colTL, colTR, colBR, colBL }, Texture::Structure::FAN);
-	}
+				if ((m_CullMode == CullMode::BACK && area >= 0.0f) || (m_CullMode == CullMode::FRONT && area <= 0.0f))
+					return;
 
-	void GameEngine::DrawTextureString(const vi2d& pos, std::string_view text, const Pixel& col, const vf2d& scale)
-	{
-		vf2d p = { 0.0f, 0.0f };
+				float nearest = std::min({ z[0], z[1], z[2] });
 
-		for (auto c : text)
+				auto AcceptTile = [&](int tileX, int tileY)
+					{
+						return !depth || nearest < depth->tileMax[tileY * depth->tiles.x + tileX];
+					};
+
+				RasterizeTriangle(screen[0], screen[1], screen[2], verts[0].pos.w, verts[1].pos.w, verts[2].pos.w,
+					[&](int x, int y, const float* linear, const float* perspective)
+					{
+						float pixelDepth = z[0] * linear[0] + z[1] * linear[1] + z[2] * linear[2];
+
+						if (depth && !depth->Test(x, y, pixelDepth))
+							return;
+
+						Pixel col = tint;
+
+						if (sprite)
+						{
+							vf2d uv = verts[0].uv * perspective[0] + verts[1].uv * perspective[1] + verts[2].uv * perspective[2];
+							col = sprite->Sample(uv, Sprite::SampleMethod::LINEAR, Sprite::WrapMethod::REPEAT);
+
+							if (tint != WHITE)
+							{
+								uint8_t alpha = uint8_t(col.a * tint.a / 255);
+
+								col = col * tint;
+								col.a = alpha;
+							}
+						}
+
+						// The pixels that the mode drops don't hide the ones behind them
+						if (Draw(x, y, col) && depth)
+							depth->Write(x, y, pixelDepth);
+					}, AcceptTile);
+
+				if (depth)
+					depth->UpdateTiles();
+			};
+
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
 		{
-			if (c == '\n')
+			// The triangles with the invalid indices are skipped
+			if (std::max({ indices[i], indices[i + 1], indices[i + 2] }) >= positions.size())
+				continue;
+
+			ClipVertex input[3];
+
+			for (int j = 0; j < 3; j++)
 			{
-				p.x = 0;
-				p.y += 8.0f * scale.y;
+				uint32_t index = indices[i + j];
+
+				input[j].pos = clip[index];
+				input[j].uv = index < uvs.size() ? uvs[index] : vf2d();
 			}
-			else if (c == '\t')
+
+			// Sutherland-Hodgman against the near plane (z = -w), a triangle turns into a quad at most
+			ClipVertex output[4];
+			int count = 0;
+
+			for (int j = 0; j < 3; j++)
 			{
-				p.x += 8.0f * float(m_TabSize) * scale.x;
+				const ClipVertex& cur = input[j];
+				const ClipVertex& next = input[(j + 1) % 3];
+
+				float curDist = cur.pos.z + cur.pos.w;
+				float nextDist = next.pos.z + next.pos.w;
+
+				if (curDist >= 0.0f)
+					output[count++] = cur;
+
+				if ((curDist >= 0.0f) != (nextDist >= 0.0f))
+				{
+					float t = curDist / (curDist - nextDist);
+
+					ClipVertex& v = output[count++];
+
+					v.pos.x = cur.pos.x + (next.pos.x - cur.pos.x) * t;
+					v.pos.y = cur.pos.y + (next.pos.y - cur.pos.y) * t;
+					v.pos.z = cur.pos.z + (next.pos.z - cur.pos.z) * t;
+					v.pos.w = cur.pos.w + (next.pos.w - cur.pos.w) * t;
+					v.uv = cur.uv + (next.uv - cur.uv) * t;
+				}
 			}
-			else
+
+			for (int j = 1; j + 1 < count; j++)
 			{
-				vf2d offset((c - 32) % 16, (c - 32) / 16);
+				ClipVertex fan[3] = { output[0], output[j], output[j + 1] };
 
-				DrawPartialTexture(pos + p, m_Font.texture, offset * 8.0f, { 8.0f, 8.0f }, scale, col);
-				p.x += 8.0f * scale.x;
+				// Points on the plane itself have w of 0 if the near plane is at 0
+				if (fan[0].pos.w > 0.0f && fan[1].pos.w > 0.0f && fan[2].pos.w > 0.0f)
+					DrawClipped(fan);
 			}
 		}
 	}
 
-	void GameEngine::DrawTriangle(const vi2d& pos1, const vi2d& pos2, const vi2d& pos3, const Pixel& col)
+	void GameEngine::ClearDepth(float value)
 	{
-		DrawTriangle(pos1.x, pos1.y, pos2.x, pos2.y, pos3.x, pos3.y, col);
+		if (m_DrawTarget->depth)
+			m_DrawTarget->depth->Clear(value);
 	}
 
-	void GameEngine::FillTriangle(const vi2d& pos1, const vi2d& pos2, const vi2d& pos3, const Pixel& col)
+	void GameEngine::SetCullMode(CullMode mode)
 	{
-		FillTriangle(pos1.x, pos1.y, pos2.x, pos2.y, pos3.x, pos3.y, col);
+		m_CullMode = mode;
+	}
+
+	CullMode GameEngine::GetCullMode() const
+	{
+		return m_CullMode;
 	}
 
 	void GameEngine::DrawRectangle(const vi2d& pos, const vi2d& size, const Pixel& col)
@@ -3824,6 +7180,7 @@ namespace def
 		texInst.tint = { tint, tint, tint, tint };
 		texInst.vertices = { pos1, { pos1.x, pos2.y }, pos2, { pos2.x, pos1.y } };
 		texInst.drawBeforeTransforms = m_DrawBeforeTransforms;
+		texInst.view = GetViewIndex();
 
 		m_Textures.push_back(texInst);
 	}
@@ -3833,8 +7190,15 @@ namespace def
 		vf2d screenPos1 = (pos * m_InvScreenSize * 2.0f - 1.0f) * vf2d(1.0f, -1.0f);
 		vf2d screenPos2 = ((pos + fileSize * scale) * m_InvScreenSize * 2.0f - 1.0f) * vf2d(1.0f, -1.0f);
 
-		vf2d quantPos1 = (screenPos1 * vf2d(m_WindowSize) + vf2d(0.5f, 0.5f)).floor() / vf2d(m_WindowSize);
-		vf2d quantPos2 = (screenPos2 * vf2d(m_WindowSize) + vf2d(0.5f, -0.5f)).ceil() / vf2d(m_WindowSize);
+		vf2d quantPos1 = screenPos1;
+		vf2d quantPos2 = screenPos2;
+
+		// World space vertices can't be snapped to the window pixels before the view transform
+		if (!m_UseViewTransform)
+		{
+			quantPos1 = (screenPos1 * vf2d(m_WindowSize) + vf2d(0.5f, 0.5f)).floor() / vf2d(m_WindowSize);
+			quantPos2 = (screenPos2 * vf2d(m_WindowSize) + vf2d(0.5f, -0.5f)).ceil() / vf2d(m_WindowSize);
+		}
 
 		vf2d tl = (filePos + 0.0001f) * tex->uvScale;
 		vf2d br = (filePos + fileSize - 0.0001f) * tex->uvScale;
@@ -3848,47 +7212,27 @@ namespace def
 		texInst.vertices = { quantPos1, { quantPos1.x, quantPos2.y }, quantPos2, { quantPos2.x, quantPos1.y } };
 		texInst.uv = { tl, { tl.x, br.y }, br, { br.x, tl.y } };
 		texInst.drawBeforeTransforms = m_DrawBeforeTransforms;
+		texInst.view = GetViewIndex();
 
 		m_Textures.push_back(texInst);
 	}
 
 	void GameEngine::DrawRotatedTexture(const vf2d& pos, const Texture* tex, float rotation, const vf2d& center, const vf2d& scale, const Pixel& tint)
 	{
-		TextureInstance texInst;
-
-		texInst.texture = tex;
-		texInst.points = 4;
-		texInst.structure = m_TextureStructure;
-		texInst.tint = { tint, tint, tint, tint };
-		texInst.drawBeforeTransforms = m_DrawBeforeTransforms;
-
-		vf2d denormCenter = center * tex->size;
-
-		texInst.vertices = {
-			-denormCenter * scale,
-			(vf2d(0.0f, tex->size.y) - denormCenter) * scale,
-			(tex->size - denormCenter) * scale,
-			(vf2d(tex->size.x, 0.0f) - denormCenter) * scale
-		};
+		DrawTexture(mat3::translate(pos) * mat3::rotate(rotation) * mat3::scale(scale) * mat3::translate(-center * tex->size), tex, tint);
+	}
 
-		float c = cos(rotation), s = sin(rotation);
-		for (int i = 0; i < texInst.points; i++)
-		{
-			vf2d offset =
-			{
-				texInst.vertices[i].x * c - texInst.vertices[i].y * s,
-				texInst.vertices[i].x * s + texInst.vertices[i].y * c
-			};
-			
-			texInst.vertices[i] = pos + offset;
-			texInst.vertices[i] = texInst.vertices[i] * m_InvScreenSize * 2.0f - 1.0f;
-			texInst.vertices[i].y *= -1.0f;
-		}
+	void GameEngine::DrawPartialRotatedTexture(const vf2d& pos, const Texture* tex, const vf2d& filePos, const vf2d& fileSize, float rotation, const vf2d& center, const vf2d& scale, const Pixel& tint)
+	{
+		DrawPartialTexture(mat3::translate(pos) * mat3::rotate(rotation) * mat3::scale(scale) * mat3::translate(-center * fileSize), tex, filePos, fileSize, tint);
+	}
 
-		m_Textures.push_back(texInst);
+	void GameEngine::DrawTexture(const mat3& transform, const Texture* tex, const Pixel& tint)
+	{
+		DrawPartialTexture(transform, tex, { 0.0f, 0.0f }, tex->size, tint);
 	}
 
-	void GameEngine::DrawPartialRotatedTexture(const vf2d& pos, const Texture* tex, const vf2d& filePos, const vf2d& fileSize, float rotation, const vf2d& center, const vf2d& scale, const Pixel& tint)
+	void GameEngine::DrawPartialTexture(const mat3& transform, const Texture* tex, const vf2d& filePos, const vf2d& fileSize, const Pixel& tint)
 	{
 		TextureInstance texInst;
 
@@ -3897,29 +7241,13 @@ namespace def
 		texInst.structure = m_TextureStructure;
 		texInst.tint = { tint, tint, tint, tint };
 		texInst.drawBeforeTransforms = m_DrawBeforeTransforms;
+		texInst.view = GetViewIndex();
 
-		vf2d denormCenter = center * fileSize;
-
-		texInst.vertices = {
-			-denormCenter * scale,
-			(vf2d(0.0f, fileSize.y) - denormCenter) * scale,
-			(fileSize - denormCenter) * scale,
-			(vf2d(fileSize.x, 0.0f) - denormCenter) * scale
-		};
-
-		float c = cos(rotation), s = sin(rotation);
-		for (int i = 0; i < texInst.points; i++)
-		{
-			vf2d offset =
-			{
-				texInst.vertices[i].x * c - texInst.vertices[i].y * s,
-				texInst.vertices[i].x * s + texInst.vertices[i].y * c
-			};
+		texInst.vertices = { { 0.0f, 0.0f }, { 0.0f, fileSize.y }, fileSize, { fileSize.x, 0.0f } };
 
-			texInst.vertices[i] = pos + offset;
-			texInst.vertices[i] = texInst.vertices[i] * m_InvScreenSize * 2.0f - 1.0f;
-			texInst.vertices[i].y *= -1.0f;
-		}
+		// Concatenating the screen to NDC mapping lets every vertex be transformed once
+		mat3 ndc = mat3(2.0f * m_InvScreenSize.x, 0.0f, -1.0f, 0.0f, -2.0f * m_InvScreenSize.y, 1.0f) * transform;
+		ndc.transform(texInst.vertices);
 
 		vf2d tl = filePos * tex->uvScale;
 		vf2d br = tl + fileSize * tex->uvScale;
@@ -3969,6 +7297,42 @@ namespace def
 		m_ClearBufferColour = col;
 	}
 
+	template <class Shader>
+	void GameEngine::ApplyShader(Graphic* target, Shader&& shader, bool readsNeighbours)
+	{
+		if (!target)
+			target = m_DrawTarget;
+
+		Sprite* source = target->sprite;
+		Sprite* dest = source;
+
+		if (readsNeighbours)
+		{
+			if (m_ShaderBuffer.size != source->size)
+				m_ShaderBuffer.Create(source->size);
+
+			dest = &m_ShaderBuffer;
+		}
+
+		const Sprite& input = *source;
+		const int width = source->size.x;
+
+		ParallelFor(0, source->size.y, 0, [&](int y)
+			{
+				Pixel* row = dest->pixels.data() + y * width;
+
+				for (int x = 0; x < width; x++)
+					row[x] = shader(vi2d(x, y), input);
+			});
+
+		if (readsNeighbours)
+			source->pixels.swap(m_ShaderBuffer.pixels);
+
+#ifdef DGE_FRAME_STATS
+		AddPixelsWritten(uint64_t(width) * uint64_t(source->size.y));
+#endif
+	}
+
 	void GameEngine::SetShader(Pixel (*func)(const vi2d&, const Pixel&, const Pixel&))
 	{
 		m_Shader = func;
@@ -4033,11 +7397,136 @@ namespace def
 		m_OnlyTextures = enable;
 	}
 
+	void GameEngine::UseViewTransform(bool enable)
+	{
+		m_UseViewTransform = enable;
+	}
+
+	bool GameEngine::IsViewTransformUsed() const
+	{
+		return m_UseViewTransform;
+	}
+
+	void GameEngine::SetViewTransform(const mat3& transform)
+	{
+		// Setting the same transform again keeps using the view that was already added
+		if (!std::equal(&transform.m[0][0], &transform.m[0][0] + 9, &m_ViewTransform.m[0][0]))
+		{
+			m_ViewTransform = transform;
+			m_ViewIndex = 0;
+		}
+	}
+
+	const mat3& GameEngine::GetViewTransform() const
+	{
+		return m_ViewTransform;
+	}
+
+	void GameEngine::UsePipelinedRendering(bool enable)
+	{
+		m_IsPipelined = enable;
+	}
+
+	bool GameEngine::IsPipelinedRendering() const
+	{
+		return m_IsPipelined;
+	}
+
 	float GameEngine::GetDeltaTime() const
 	{
 		return m_DeltaTime;
 	}
 
+	bool GameEngine::StartRecording(std::string_view fileName)
+	{
+		StopRecording();
+
+		m_RecordFile.open(fileName.data(), std::ios::binary);
+
+		if (!m_RecordFile.is_open())
+			return false;
+
+		m_RecordFile.write("DGEI", 4);
+
+		for (int i = 0; i < 512; i++)
+			m_RecordedFrame.keys[i] = false;
+
+		return true;
+	}
+
+	void GameEngine::StopRecording()
+	{
+		if (m_RecordFile.is_open())
+			m_RecordFile.close();
+	}
+
+	bool GameEngine::IsRecording() const
+	{
+		return m_RecordFile.is_open();
+	}
+
+	bool GameEngine::StartReplay(std::string_view fileName, float fixedDeltaTime, bool closeOnEnd)
+	{
+		StopReplay();
+
+		m_ReplayFile.open(fileName.data(), std::ios::binary);
+
+		if (!m_ReplayFile.is_open())
+			return false;
+
+		char magic[4];
+
+		if (!m_ReplayFile.read(magic, 4) || std::string_view(magic, 4) != "DGEI")
+		{
+			m_ReplayFile.close();
+			return false;
+		}
+
+		for (int i = 0; i < 512; i++)
+			m_ReplayedFrame.keys[i] = false;
+
+		m_ReplayDeltaTime = fixedDeltaTime;
+		m_CloseOnReplayEnd = closeOnEnd;
+
+		return true;
+	}
+
+	void GameEngine::StopReplay()
+	{
+		if (m_ReplayFile.is_open())
+			m_ReplayFile.close();
+	}
+
+	bool GameEngine::IsReplaying() const
+	{
+		return m_ReplayFile.is_open();
+	}
+
+	Platform* GameEngine::GetPlatform()
+	{
+		return m_Platform;
+	}
+
+	ThreadPool& GameEngine::GetThreadPool()
+	{
+		if (!m_ThreadPool)
+			m_ThreadPool = std::make_unique<ThreadPool>();
+
+		return *m_ThreadPool;
+	}
+
+	template <class F>
+	void GameEngine::ParallelFor(int begin, int end, int grain, F&& func)
+	{
+		GetThreadPool().ParallelFor(begin, end, grain, std::forward<F>(func));
+	}
+
+	void GameEngine::WaitAll()
+	{
+		if (m_ThreadPool)
+			m_ThreadPool->WaitAll();
+	}
+
 #endif
 
 }